@@ -0,0 +1,212 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "buffer_pool.h"
+
+#include <cstdlib>
+#include <new>
+
+using std::size_t;
+
+namespace ceng391 {
+
+// Every block starts with a header that remembers its size class, it is as
+// large as the alignment so that the pixels stay aligned.
+static const size_t header_size = BufferPool::alignment;
+static const size_t min_block = 4096;
+static const size_t max_block = (size_t) 1 << 36;
+static const int huge_class = -1;
+
+BufferPool& BufferPool::instance()
+{
+        static BufferPool pool;
+        return pool;
+}
+
+BufferPool::BufferPool()
+{
+        m_cached_bytes = 0;
+        m_max_cached = (size_t) 512 << 20;
+
+        for (size_t base = min_block; base < max_block; base *= 2) {
+                for (int quarter = 4; quarter < 8; ++quarter) {
+                        SizeClass c;
+                        c.block_size = base / 4 * quarter;
+                        c.hits = 0;
+                        c.misses = 0;
+                        c.in_use = 0;
+                        m_classes.push_back(c);
+                }
+        }
+}
+
+BufferPool::~BufferPool()
+{
+        trim(0);
+}
+
+int BufferPool::find_class(size_t size) const
+{
+        if (size > m_classes.back().block_size)
+                return huge_class;
+
+        int lo = 0;
+        int hi = (int) m_classes.size() - 1;
+        while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (m_classes[mid].block_size < size)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        return lo;
+}
+
+static uchar* allocate_block(size_t block_size, int size_class)
+{
+        void* block = 0;
+        if (posix_memalign(&block, BufferPool::alignment, header_size + block_size) != 0)
+                throw std::bad_alloc();
+
+        *static_cast<int*>(block) = size_class;
+        return static_cast<uchar*>(block) + header_size;
+}
+
+uchar* BufferPool::acquire(size_t size)
+{
+        int size_class = find_class(size);
+        if (size_class == huge_class)
+                return allocate_block(size, huge_class);
+
+        {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                SizeClass& c = m_classes[size_class];
+                ++c.in_use;
+                if (!c.free_list.empty()) {
+                        uchar* buffer = c.free_list.back();
+                        c.free_list.pop_back();
+                        m_cached_bytes -= c.block_size;
+                        ++c.hits;
+                        return buffer;
+                }
+                ++c.misses;
+        }
+
+        return allocate_block(m_classes[size_class].block_size, size_class);
+}
+
+void BufferPool::release(uchar* buffer)
+{
+        if (buffer == 0)
+                return;
+
+        uchar* block = buffer - header_size;
+        int size_class = *reinterpret_cast<int*>(block);
+        if (size_class != huge_class) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                SizeClass& c = m_classes[size_class];
+                --c.in_use;
+                if (m_cached_bytes + c.block_size <= m_max_cached) {
+                        c.free_list.push_back(buffer);
+                        m_cached_bytes += c.block_size;
+                        return;
+                }
+        }
+
+        free(block);
+}
+
+void BufferPool::trim(size_t max_cached)
+{
+        std::vector<uchar*> victims;
+        {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                // drop the largest blocks first
+                for (int i = (int) m_classes.size() - 1; i >= 0; --i) {
+                        SizeClass& c = m_classes[i];
+                        while (m_cached_bytes > max_cached && !c.free_list.empty()) {
+                                victims.push_back(c.free_list.back());
+                                c.free_list.pop_back();
+                                m_cached_bytes -= c.block_size;
+                        }
+                }
+        }
+
+        for (size_t i = 0; i < victims.size(); ++i)
+                free(victims[i] - header_size);
+}
+
+void BufferPool::set_max_cached(size_t max_cached)
+{
+        {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_max_cached = max_cached;
+        }
+        trim(max_cached);
+}
+
+size_t BufferPool::cached_bytes() const
+{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_cached_bytes;
+}
+
+std::vector<BufferPool::Stats> BufferPool::stats() const
+{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<Stats> result;
+        for (size_t i = 0; i < m_classes.size(); ++i) {
+                const SizeClass& c = m_classes[i];
+                if (c.hits == 0 && c.misses == 0)
+                        continue;
+
+                Stats s;
+                s.block_size = c.block_size;
+                s.hits = c.hits;
+                s.misses = c.misses;
+                s.in_use = c.in_use;
+                s.cached = c.free_list.size();
+                result.push_back(s);
+        }
+        return result;
+}
+
+void BufferPool::print_stats(std::ostream& out) const
+{
+        std::vector<Stats> s = stats();
+        out << "block_size hits misses in_use cached\n";
+        for (size_t i = 0; i < s.size(); ++i) {
+                out << s[i].block_size << " " << s[i].hits << " " << s[i].misses
+                    << " " << s[i].in_use << " " << s[i].cached << "\n";
+        }
+        out << "cached bytes: " << cached_bytes() << "\n";
+}
+
+}
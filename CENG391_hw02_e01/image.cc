@@ -29,44 +29,120 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // ------------------------------
 #include "image.h"
+#include "buffer_pool.h"
+#include "resize.h"
+#include "upscale.h"
+#include "trace.h"
 
 #include <iostream>
-#include <fstream>
+#include <cerrno>
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 
-using std::ofstream;
-using std::ios;
 using std::cerr;
 using std::string;
-using std::fopen;
-using std::fputc;
 using std::exit;
-using std::fclose;
-using std::fscanf;
-using std::fread;
 using std::cos;
 using std::sin;
 
 namespace ceng391 {
 
-Image::Image(int width, int height, int n_channels, int step)
+static int round_up(int value, int align)
+{
+        return (value + align - 1) / align * align;
+}
+
+Image::Image(int width, int height, int n_channels, int step, int border)
 {
         m_width = width;
         m_height = height;
         m_n_channels = n_channels;
+        m_border = border > 0 ? border : 0;
+
+        int left = m_border > 0 ? round_up(m_border*m_n_channels, row_align) : 0;
+        int min_step = left + (m_width + m_border)*m_n_channels;
+        if (step < 0)
+                m_step = round_up(min_step, row_align);
+        else
+                m_step = min_step < step ? step : min_step;
+
+        size_t size = (size_t) m_step*(m_height + 2*m_border);
+        m_buffer = allocate_pixels(size);
+        if (m_border > 0)
+                memset(m_buffer, 0, size);
+        m_data = m_buffer + (size_t) m_border*m_step + left;
+        m_mapped_size = 0;
+}
 
-        m_step = m_width*m_n_channels;
-        if (m_step < step)
-                m_step = step;
-        m_data = new uchar[m_step*height];
+Image::Image()
+{
+        m_width = 0;
+        m_height = 0;
+        m_n_channels = 0;
+        m_step = 0;
+        m_border = 0;
+        m_data = 0;
+        m_buffer = 0;
+        m_mapped_size = 0;
 }
 
 Image::~Image()
 {
-        delete [] m_data;
+        release_data();
+}
+
+int Image::aligned_step(int width, int n_channels)
+{
+        return round_up(width*n_channels, row_align);
+}
+
+uchar* Image::allocate_pixels(size_t size)
+{
+        return BufferPool::instance().acquire(size);
+}
+
+void Image::free_pixels(uchar* pixels)
+{
+        BufferPool::instance().release(pixels);
+}
+
+void Image::release_data()
+{
+        if (m_mapped_size != 0)
+                munmap(m_buffer, m_mapped_size);
+        else
+                free_pixels(m_buffer);
+
+        m_data = 0;
+        m_buffer = 0;
+        m_mapped_size = 0;
+}
+
+void Image::take_data(Image* other)
+{
+        release_data();
+        m_width = other->m_width;
+        m_height = other->m_height;
+        m_n_channels = other->m_n_channels;
+        m_step = other->m_step;
+        m_border = other->m_border;
+        m_data = other->m_data;
+        m_buffer = other->m_buffer;
+        m_mapped_size = other->m_mapped_size;
+
+        other->m_data = 0;
+        other->m_buffer = 0;
+        other->m_mapped_size = 0;
+        delete other;
 }
 
 Image* Image::new_gray(int width, int height)
@@ -80,6 +156,11 @@ Image* Image::new_rgb(int width, int height)
 }
 
 void Image::set_rect(int x, int y, int width, int height, uchar value)
+{
+        view().set_rect(x, y, width, height, value);
+}
+
+ImageView ImageView::sub(int x, int y, int width, int height) const
 {
         if (x < 0) {
                 width += x;
@@ -91,175 +172,261 @@ void Image::set_rect(int x, int y, int width, int height, uchar value)
                 y = 0;
         }
 
-        for (int j = y; j < y+height; ++j) {
-                if (j >= m_height)
-                        break;
-                uchar* row_data = data(j);
-                for (int i = x; i < x+width; ++i) {
-                        if (i >= m_width)
-                                break;
-                        for (int c = 0; c < m_n_channels; ++c)
-                                row_data[i*m_n_channels + c] = value;
-                }
-        }
+        if (x > m_width)
+                x = m_width;
+        if (y > m_height)
+                y = m_height;
+        if (width > m_width - x)
+                width = m_width - x;
+        if (height > m_height - y)
+                height = m_height - y;
+        if (width < 0)
+                width = 0;
+        if (height < 0)
+                height = 0;
+
+        return ImageView(data(y) + x*m_n_channels, width, height, m_n_channels, m_step);
+}
+
+void ImageView::set_rect(int x, int y, int width, int height, uchar value) const
+{
+        TRACE_SCOPE("set_rect");
+        ImageView r = sub(x, y, width, height);
+        const size_t row_size = (size_t) r.m_width*m_n_channels;
+        for (int j = 0; j < r.m_height; ++j)
+                memset(r.data(j), value, row_size);
 }
 
 uchar* Image::scaleup_nn(int scale) {
-        int height = scale * m_height;
-        int width = scale * m_width;
-        int step = width;
-        uchar* imgScaled = new uchar[step * height];
-
-        // initialize all pixel to black
-        for(int i = 0; i < height; i++) {
-                for(int j = 0; j < width; j++) {
-                        imgScaled[step * i + j] = 0;
-                }
-        }
+        take_data(scaleup_nn(view(), scale));
+        return m_data;
+}
 
-        for(int i = 0; i < height; i++) {
-                for(int j = 0; j < width; j++) {
-                        imgScaled[step * i + j] = data((int) round(i / scale))[(int) round(j / scale)];
-                }
-        }
-        
-        m_step = step;
-        m_height = height;
-        m_width = width;
-        
-        delete m_data;
-        m_data = imgScaled;
+uchar* Image::scaleup_bilinear(int scale) {
+        take_data(scaleup_bilinear(view(), scale));
+        return m_data;
+}
 
-        return imgScaled;
+Image* Image::scaleup_nn(const ImageView& src, int scale) {
+        Image* scaled = new Image(scale * src.w(), scale * src.h(), src.n_ch());
+        upscale_nn(src, scaled->view(), scale);
+        return scaled;
 }
 
-uchar* Image::scaleup_bilinear(int scale) {
-        int height = scale * m_height;
-        int width = scale * m_width;
-        int step = width;
-        
-        float iRatio = (m_height - 1) / (float) height;
-        float jRatio = (m_width - 1) / (float) width;
-
-        uchar* imgScaled = new uchar[step * height];
-
-        // initialize all pixel to black
-        for(int i = 0; i < height; i++) {
-                for(int j = 0; j < width; j++) {
-                        imgScaled[step * i + j] = 0;
-                }
-        }
+Image* Image::scaleup_bilinear(const ImageView& src, int scale) {
+        Image* scaled = new Image(scale * src.w(), scale * src.h(), src.n_ch());
+        upscale_bilinear(src, scaled->view(), scale);
+        return scaled;
+}
 
-        for(int i = 0; i < height; i++) {
-                for(int j = 0; j < width; j++) {
-                        int x = (int) (iRatio * i);
-                        int y = (int) (jRatio * j);
-                 
-                        float alpha = iRatio * i- x;
-                        float beta = jRatio * j - y;
-                
-                        int intensity =   (1 - alpha) * (1 - beta) * m_data[m_step * x + y]
-                                        + alpha       * (1 - beta) * m_data[m_step * (x + 1) + y]
-                                        + (1 - alpha) * beta       * m_data[m_step * x + y + 1]
-                                        + alpha       * beta       * m_data[m_step * (x + 1) + y + 1];
-                        
-                        imgScaled[step * i + j] = intensity;
+uchar* Image::resize(int width, int height) {
+        take_data(resize(view(), width, height));
+        return m_data;
+}
+
+Image* Image::resize(const ImageView& src, int width, int height) {
+        Image* resized = new Image(width, height, src.n_ch());
+        resample(src, resized->view());
+        return resized;
+}
+
+static bool writev_all(int fd, struct iovec* iov, int n_iov)
+{
+        while (n_iov > 0) {
+                ssize_t n = writev(fd, iov, n_iov);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return false;
+                }
+                while (n_iov > 0 && (size_t) n >= iov->iov_len) {
+                        n -= iov->iov_len;
+                        ++iov;
+                        --n_iov;
+                }
+                if (n_iov > 0) {
+                        iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                        iov->iov_len -= n;
                 }
         }
-        
-        m_step = step;
-        m_height = height;
-        m_width = width;
-        
-        delete m_data;
-        m_data = imgScaled;
-
-        return 0;
+        return true;
 }
 
 bool Image::write_pnm(const std::string& filename) const
 {
-        if (m_n_channels != 1) {
-                cerr << "[ERROR][CENG391::Image] Currently only grayscale images can be saved as PNM files!\n";
+        return view().write_pnm(filename);
+}
+
+bool ImageView::write_pnm(const std::string& filename) const
+{
+        TRACE_SCOPE("write_pnm");
+        string magic_head;
+        string extended_name;
+        if (m_n_channels == 1) {
+                magic_head = "P5";
+                extended_name = filename + ".pgm";
+        } else if (m_n_channels == 3) {
+                magic_head = "P6";
+                extended_name = filename + ".ppm";
+        } else {
+                cerr << "[ERROR][CENG391::Image] Only grayscale and rgb images can be saved as PNM files!\n";
                 return false;
         }
 
-        const string magic_head = "P5";
-        ofstream fout;
-        string extended_name = filename + ".pgm";
-        fout.open(extended_name.c_str(), ios::out | ios::binary);
-        fout << magic_head << "\n";
-        fout << m_width << " " << m_height << " 255\n";
-        for (int y = 0; y < m_height; ++y) {
-                const uchar *row_data = data(y);
-                fout.write(reinterpret_cast<const char*>(row_data), m_width*sizeof(uchar));
+        int fd = open(extended_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+                cerr << "[ERROR][CENG391::Image] Could not open " << extended_name << " for writing!\n";
+                return false;
         }
-        fout.close();
 
-        return true;
+        char header[64];
+        int header_size = snprintf(header, sizeof(header), "%s\n%d %d 255\n",
+                                   magic_head.c_str(), m_width, m_height);
+
+        // rows are gathered into a single writev call per batch, or written
+        // in one piece together with the header when there is no padding
+        const size_t row_size = (size_t) m_width*m_n_channels;
+        const int max_iov = 256;
+        struct iovec iov[max_iov];
+        iov[0].iov_base = header;
+        iov[0].iov_len = header_size;
+        int n_iov = 1;
+        bool ok = true;
+        if ((size_t) m_step == row_size) {
+                iov[1].iov_base = const_cast<uchar*>(m_data);
+                iov[1].iov_len = row_size*m_height;
+                ok = writev_all(fd, iov, 2);
+        } else {
+                for (int y = 0; y < m_height && ok; ++y) {
+                        iov[n_iov].iov_base = const_cast<uchar*>(data(y));
+                        iov[n_iov].iov_len = row_size;
+                        if (++n_iov == max_iov || y == m_height - 1) {
+                                ok = writev_all(fd, iov, n_iov);
+                                n_iov = 0;
+                        }
+                }
+                if (ok && m_height == 0)
+                        ok = writev_all(fd, iov, n_iov);
+        }
+
+        if (close(fd) != 0)
+                ok = false;
+        if (!ok)
+                cerr << "[ERROR][CENG391::Image] Could not write " << extended_name << "!\n";
+
+        return ok;
 }
 
-Image* Image::read_pnm(const std::string& filename)
+static const uchar* skip_pnm_space(const uchar* p, const uchar* end)
 {
-        FILE *pnm = fopen(filename.c_str(), "rb");
-        if (!pnm) {
-                fprintf(stderr, "Could not open image file %s\n", filename.c_str());
-                exit(EXIT_FAILURE);
+        while (p < end) {
+                if (*p == '#') {
+                        while (p < end && *p != '\n')
+                                ++p;
+                } else if (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') {
+                        ++p;
+                } else {
+                        break;
+                }
         }
+        return p;
+}
 
-        char ch1, ch2;
-        if (fscanf(pnm, "%c%c", &ch1, &ch2) != 2) {
-                fprintf(stderr, "Could not read image header from %s\n", filename.c_str());
-                exit(EXIT_FAILURE);
+static const uchar* parse_pnm_int(const uchar* p, const uchar* end, int* value)
+{
+        p = skip_pnm_space(p, end);
+        if (p == end || *p < '0' || *p > '9')
+                return 0;
+
+        int v = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+                if (v > 100000000)
+                        return 0;
+                v = v*10 + (*p - '0');
+                ++p;
         }
+        *value = v;
+        return p;
+}
 
-        if(ch1 != 'P' || (ch2 != '5' && ch2 != '6')) {
-                fprintf(stderr, "Image %s is not a valid binary PGM or PPM file", filename.c_str());
+Image* Image::read_pnm(const std::string& filename)
+{
+        string error;
+        Image* img = load_pnm(filename, &error);
+        if (!img) {
+                fprintf(stderr, "%s\n", error.c_str());
                 exit(EXIT_FAILURE);
         }
+        return img;
+}
 
-        int n_ch = -1;
-        if(ch2 == '5') {
-                n_ch = 1;
-        } else if(ch2 == '6') {
-                n_ch = 3;
+Image* Image::load_pnm(const std::string& filename, std::string* error)
+{
+        TRACE_SCOPE("read_pnm");
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+                *error = "Could not open image file " + filename;
+                return 0;
         }
 
-        int c = fgetc(pnm);
-        while (c == ' ' || c == '\n' || c == '\t') {
-                c = fgetc(pnm);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < 2) {
+                close(fd);
+                *error = "Could not read image header from " + filename;
+                return 0;
         }
 
-        while (c == '#') {
-                while (c != '\n') {
-                        c = fgetc(pnm);
-                        if (c == EOF) {
-                                fprintf(stderr, "%s does not contain image data", filename.c_str());
-                                exit(EXIT_FAILURE);
-                        }
-                }
-                c = fgetc(pnm);
+        size_t file_size = st.st_size;
+        void* mapping = mmap(0, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+                *error = "Could not map image file " + filename;
+                return 0;
         }
-        ungetc(c, pnm);
 
+        const uchar* begin = static_cast<const uchar*>(mapping);
+        const uchar* end = begin + file_size;
+        int n_ch = -1;
         int pnm_width;
         int pnm_height;
         int pnm_levels;
-        if (fscanf(pnm, "%d %d %d", &pnm_width, &pnm_height, &pnm_levels) != 3) {
-                fprintf(stderr, "Could not read image attributes from %s", filename.c_str());
-                exit(EXIT_FAILURE);
-        }
-        c = fgetc(pnm);
-
-        Image* img = new Image(pnm_width, pnm_height, n_ch);
-        for (int y = 0; y < img->m_height; ++y) {
-                uchar* row = img->data(y);
-                if (fread((void*)row, sizeof(uchar), img->m_width*n_ch, pnm) != img->m_width*n_ch) {
-                        fprintf(stderr, "Could not read data line %d from %s", y, filename.c_str());
-                        exit(EXIT_FAILURE);
+        const uchar* p = begin + 2;
+        if(begin[0] != 'P' || (begin[1] != '5' && begin[1] != '6')) {
+                *error = "Image " + filename + " is not a valid binary PGM or PPM file";
+        } else if ((p = parse_pnm_int(p, end, &pnm_width)) == 0
+                   || (p = parse_pnm_int(p, end, &pnm_height)) == 0
+                   || (p = parse_pnm_int(p, end, &pnm_levels)) == 0
+                   || p == end) {
+                *error = "Could not read image attributes from " + filename;
+        } else if (pnm_levels < 1 || pnm_levels > 255) {
+                *error = "Image " + filename + " does not have 8 bit samples";
+        } else {
+                n_ch = begin[1] == '5' ? 1 : 3;
+                // a single whitespace character separates the header from
+                // the data
+                ++p;
+                size_t data_size = (size_t) pnm_width * pnm_height * n_ch;
+                if ((size_t) (end - p) < data_size) {
+                        *error = filename + " does not contain enough image data";
+                        n_ch = -1;
                 }
         }
-        fclose(pnm);
+        if (n_ch < 0) {
+                munmap(mapping, file_size);
+                return 0;
+        }
+
+        madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+        Image* img = new Image();
+        img->m_width = pnm_width;
+        img->m_height = pnm_height;
+        img->m_n_channels = n_ch;
+        img->m_step = pnm_width * n_ch;
+        img->m_border = 0;
+        img->m_buffer = static_cast<uchar*>(mapping);
+        img->m_data = img->m_buffer + (p - begin);
+        img->m_mapped_size = file_size;
 
         return img;
 }
@@ -31,17 +31,59 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <cstddef>
 #include <string>
 
 #include "util.h"
 
 namespace ceng391 {
 
+// Non-owning reference to a rectangle of pixels with a row step, e.g. a
+// region of an Image. Views are cheap to copy and never free the pixels, the
+// image they point into must outlive them.
+class ImageView {
+public:
+        ImageView()
+                : m_data(0), m_width(0), m_height(0), m_n_channels(0), m_step(0) {}
+        ImageView(uchar* data, int width, int height, int n_channels, int step)
+                : m_data(data), m_width(width), m_height(height),
+                  m_n_channels(n_channels), m_step(step) {}
+
+        int w   () const { return m_width; }
+        int h   () const { return m_height; }
+        int n_ch() const { return m_n_channels; }
+        int step() const { return m_step; }
+
+        uchar* data() const { return m_data; }
+        uchar* data(int y) const { return m_data + (std::ptrdiff_t) y*m_step; }
+
+        // Region of this view, clipped to its bounds.
+        ImageView sub(int x, int y, int width, int height) const;
+
+        void set_rect(int x, int y, int width, int height, uchar value) const;
+        void set(uchar value) const { set_rect(0, 0, m_width, m_height, value); }
+
+        bool write_pnm(const std::string& filename) const;
+private:
+        uchar* m_data;
+        int m_width;
+        int m_height;
+        int m_n_channels;
+        int m_step;
+};
+
 class Image {
 public:
-        Image(int width, int height, int n_channels, int step = -1);
+        // Unless an explicit step is given, rows are padded to a multiple
+        // of row_align bytes and every row starts on a row_align boundary.
+        // A positive border adds that many zeroed guard pixels on each side
+        // so that kernels may read a few pixels past the edges.
+        Image(int width, int height, int n_channels, int step = -1, int border = 0);
         ~Image();
 
+        static const int row_align = 64;
+        static int aligned_step(int width, int n_channels);
+
         static Image* new_gray(int width, int height);
         static Image* new_rgb(int width, int height);
 
@@ -49,6 +91,10 @@ public:
         int h   () const { return m_height; }
         int n_ch() const { return m_n_channels; }
         int step() const { return m_step; }
+        int border() const { return m_border; }
+
+        ImageView view() const { return ImageView(m_data, m_width, m_height, m_n_channels, m_step); }
+        ImageView view(int x, int y, int width, int height) const { return view().sub(x, y, width, height); }
 
         uchar*       data()       { return m_data; }
         const uchar* data() const { return m_data; }
@@ -59,17 +105,46 @@ public:
         void set(uchar value) { set_rect(0, 0, m_width, m_height, value); }
         void set_zero() { set(0); }
 
+        // Scale this image in place and return its new pixels.
         uchar* scaleup_nn(int scale);
         uchar* scaleup_bilinear(int scale);
+        // Scaled copies of src, which may be a region of another image.
+        static Image* scaleup_nn(const ImageView& src, int scale);
+        static Image* scaleup_bilinear(const ImageView& src, int scale);
+
+        // Resamples to an arbitrary size, see resize.h for the filter.
+        uchar* resize(int width, int height);
+        static Image* resize(const ImageView& src, int width, int height);
         
         bool write_pnm(const std::string& filename) const;
+        // Maps the file into memory and returns an image whose data()
+        // points into the mapping. The mapping is private so writing to
+        // the pixels copies the touched pages and never changes the file.
+        // Exits the program when the file cannot be read.
         static Image* read_pnm(const std::string& filename);
+        // Same as read_pnm(), but returns null and describes the problem
+        // in error instead of exiting.
+        static Image* load_pnm(const std::string& filename, std::string* error);
+
+        bool is_mapped() const { return m_mapped_size != 0; }
 private:
+        Image();
+
+        static uchar* allocate_pixels(std::size_t size);
+        static void free_pixels(uchar* pixels);
+
+        void release_data();
+        void take_data(Image* other);
+
         int m_width;
         int m_height;
         int m_n_channels;
         int m_step;
+        int m_border;
         uchar* m_data;
+        // start of the allocation or mapping that m_data points into
+        uchar* m_buffer;
+        std::size_t m_mapped_size;
 };
 
 }
@@ -0,0 +1,61 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+namespace ceng391 {
+
+// Splits the rows [0, n_rows) into chunks of chunk_rows rows and runs
+// body(first, last) on each chunk, using the shared pool of worker threads
+// and the calling thread. Returns once every chunk is done. Rows must be
+// independent of each other, the result is then the same for any number of
+// threads. A chunk_rows of 0 uses the default chunk size.
+//
+// Calls made from inside a body, or while another thread is using the pool,
+// run serially on the calling thread.
+void parallel_for_rows(int n_rows, const std::function<void(int, int)>& body,
+                       int chunk_rows = 0);
+
+// Number of threads used including the calling thread. Defaults to the
+// CENG391_NUM_THREADS environment variable or the number of cores. Loops
+// that are running while the number changes finish on the old threads.
+void set_num_threads(int n_threads);
+int num_threads();
+
+// Default chunk size, 0 picks about four chunks per thread.
+void set_chunk_rows(int chunk_rows);
+int chunk_rows();
+
+}
+
+#endif
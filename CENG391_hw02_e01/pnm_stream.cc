@@ -0,0 +1,450 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "pnm_stream.h"
+#include "point_op.h"
+#include "resize.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using std::fopen;
+using std::fclose;
+using std::fread;
+using std::fwrite;
+using std::fprintf;
+using std::memcpy;
+
+namespace ceng391 {
+
+PnmReader::PnmReader()
+{
+        m_file = 0;
+        m_width = 0;
+        m_height = 0;
+        m_n_channels = 0;
+        m_row = 0;
+}
+
+PnmReader::~PnmReader()
+{
+        close();
+}
+
+void PnmReader::close()
+{
+        if (m_file)
+                fclose(m_file);
+        m_file = 0;
+}
+
+static int read_header_int(FILE* f, int* value)
+{
+        int c = fgetc(f);
+        for (;;) {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF)
+                                c = fgetc(f);
+                } else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+                        c = fgetc(f);
+                } else {
+                        break;
+                }
+        }
+        if (c < '0' || c > '9')
+                return 0;
+
+        int v = 0;
+        while (c >= '0' && c <= '9') {
+                if (v > 100000000)
+                        return 0;
+                v = v*10 + (c - '0');
+                c = fgetc(f);
+        }
+        // c is the single whitespace character after the number
+        *value = v;
+        return 1;
+}
+
+bool PnmReader::open(const std::string& filename)
+{
+        close();
+        m_file = fopen(filename.c_str(), "rb");
+        if (!m_file) {
+                fprintf(stderr, "Could not open image file %s\n", filename.c_str());
+                return false;
+        }
+        setvbuf(m_file, 0, _IOFBF, 1 << 20);
+
+        int ch1 = fgetc(m_file);
+        int ch2 = fgetc(m_file);
+        if (ch1 != 'P' || (ch2 != '5' && ch2 != '6')) {
+                fprintf(stderr, "Image %s is not a valid binary PGM or PPM file\n", filename.c_str());
+                close();
+                return false;
+        }
+        m_n_channels = ch2 == '5' ? 1 : 3;
+
+        int levels;
+        if (!read_header_int(m_file, &m_width) || !read_header_int(m_file, &m_height)
+            || !read_header_int(m_file, &levels)) {
+                fprintf(stderr, "Could not read image attributes from %s\n", filename.c_str());
+                close();
+                return false;
+        }
+        if (levels < 1 || levels > 255) {
+                fprintf(stderr, "Image %s does not have 8 bit samples\n", filename.c_str());
+                close();
+                return false;
+        }
+        // rows, including their alignment padding, are sized with ints
+        if (m_width <= 0 || m_height <= 0
+            || m_width > (INT_MAX - Image::row_align)/m_n_channels) {
+                fprintf(stderr, "Image %s has an invalid size %dx%d\n", filename.c_str(),
+                        m_width, m_height);
+                close();
+                return false;
+        }
+        m_row = 0;
+
+        return true;
+}
+
+int PnmReader::read_rows(Image* band, int y0, int n_rows)
+{
+        if (n_rows > rows_left())
+                n_rows = rows_left();
+        if (n_rows > band->h() - y0)
+                n_rows = band->h() - y0;
+
+        const size_t row_size = (size_t) m_width*m_n_channels;
+        for (int y = 0; y < n_rows; ++y) {
+                if (fread(band->data(y0 + y), 1, row_size, m_file) != row_size) {
+                        fprintf(stderr, "Could not read data line %d\n", m_row);
+                        m_row = m_height;
+                        return y;
+                }
+                ++m_row;
+        }
+
+        return n_rows;
+}
+
+PnmWriter::PnmWriter()
+{
+        m_file = 0;
+        m_width = 0;
+        m_height = 0;
+        m_n_channels = 0;
+        m_row = 0;
+}
+
+PnmWriter::~PnmWriter()
+{
+        close();
+}
+
+bool PnmWriter::open(const std::string& filename, int width, int height, int n_channels)
+{
+        close();
+        if (n_channels != 1 && n_channels != 3) {
+                fprintf(stderr, "Only grayscale and rgb images can be saved as PNM files\n");
+                return false;
+        }
+
+        m_file = fopen(filename.c_str(), "wb");
+        if (!m_file) {
+                fprintf(stderr, "Could not open %s for writing\n", filename.c_str());
+                return false;
+        }
+        setvbuf(m_file, 0, _IOFBF, 1 << 20);
+
+        m_width = width;
+        m_height = height;
+        m_n_channels = n_channels;
+        m_row = 0;
+        fprintf(m_file, "%s\n%d %d 255\n", n_channels == 1 ? "P5" : "P6", width, height);
+
+        return true;
+}
+
+bool PnmWriter::close()
+{
+        if (!m_file)
+                return true;
+
+        bool ok = m_row == m_height;
+        if (fclose(m_file) != 0)
+                ok = false;
+        m_file = 0;
+
+        return ok;
+}
+
+bool PnmWriter::write_row(const uchar* row)
+{
+        if (m_row >= m_height)
+                return false;
+
+        const size_t row_size = (size_t) m_width*m_n_channels;
+        if (fwrite(row, 1, row_size, m_file) != row_size)
+                return false;
+        ++m_row;
+
+        return true;
+}
+
+bool PnmWriter::write_rows(const Image* band, int y0, int n_rows)
+{
+        for (int y = 0; y < n_rows; ++y) {
+                if (!write_row(band->data(y0 + y)))
+                        return false;
+        }
+        return true;
+}
+
+// Outputs and bands are sized with ints like the images read.
+static bool valid_stream_size(long long width, long long height, int n_ch)
+{
+        return width > 0 && height > 0 && height <= INT_MAX
+                && width <= (INT_MAX - Image::row_align)/n_ch;
+}
+
+static bool valid_band_rows(int band_rows)
+{
+        if (band_rows < 1) {
+                fprintf(stderr, "Bands need at least one row, not %d\n", band_rows);
+                return false;
+        }
+        return true;
+}
+
+bool stream_bands(const std::string& in, const std::string& out, BandOp* op, int band_rows)
+{
+        if (!valid_band_rows(band_rows))
+                return false;
+
+        PnmReader reader;
+        if (!reader.open(in))
+                return false;
+
+        PnmWriter writer;
+        if (!writer.open(out, reader.w(), reader.h(), reader.n_ch()))
+                return false;
+
+        Image band(reader.w(), band_rows, reader.n_ch());
+        int y0 = 0;
+        while (reader.rows_left() > 0) {
+                int n = reader.read_band(&band);
+                if (n == 0)
+                        return false;
+                op->apply(&band, y0, n);
+                if (!writer.write_rows(&band, 0, n))
+                        return false;
+                y0 += n;
+        }
+
+        return writer.close();
+}
+
+class SetRectOp: public BandOp {
+public:
+        SetRectOp(int x, int y, int width, int height, uchar value)
+                : m_x(x), m_y(y), m_width(width), m_height(height), m_value(value) {}
+
+        void apply(Image* band, int y0, int n_rows)
+        {
+                int top = m_y - y0;
+                int bottom = top + m_height;
+                if (bottom > n_rows)
+                        bottom = n_rows;
+                if (top < n_rows && bottom > 0)
+                        band->set_rect(m_x, top, m_width, bottom - top, m_value);
+        }
+private:
+        int m_x, m_y, m_width, m_height;
+        uchar m_value;
+};
+
+class TransformOp: public BandOp {
+public:
+        TransformOp(float alpha, int c) : m_op(alpha, c) {}
+
+        void apply(Image* band, int, int n_rows)
+        {
+                for (int y = 0; y < n_rows; ++y)
+                        point_op_row(m_op, band->data(y), band->data(y), band->w()*band->n_ch());
+        }
+private:
+        PointOp m_op;
+};
+
+bool stream_set_rect(const std::string& in, const std::string& out,
+                     int x, int y, int width, int height, uchar value, int band_rows)
+{
+        SetRectOp op(x, y, width, height, value);
+        return stream_bands(in, out, &op, band_rows);
+}
+
+bool stream_transform(const std::string& in, const std::string& out,
+                      float alpha, int c, int band_rows)
+{
+        TransformOp op(alpha, c);
+        return stream_bands(in, out, &op, band_rows);
+}
+
+bool stream_scaleup_nn(const std::string& in, const std::string& out,
+                       int scale, int band_rows)
+{
+        if (!valid_band_rows(band_rows))
+                return false;
+
+        PnmReader reader;
+        if (!reader.open(in))
+                return false;
+
+        const int n_ch = reader.n_ch();
+        if (scale < 1 || !valid_stream_size((long long) scale*reader.w(),
+                                            (long long) scale*reader.h(), n_ch)) {
+                fprintf(stderr, "Invalid scale %d for %s\n", scale, in.c_str());
+                return false;
+        }
+
+        PnmWriter writer;
+        if (!writer.open(out, scale*reader.w(), scale*reader.h(), n_ch))
+                return false;
+
+        Image band(reader.w(), band_rows, n_ch);
+        Image row(scale*reader.w(), 1, n_ch);
+        while (reader.rows_left() > 0) {
+                int n = reader.read_band(&band);
+                if (n == 0)
+                        return false;
+
+                for (int y = 0; y < n; ++y) {
+                        const uchar* src = band.data(y);
+                        uchar* dst = row.data();
+                        for (int x = 0; x < reader.w(); ++x) {
+                                for (int s = 0; s < scale; ++s) {
+                                        memcpy(dst, src, n_ch);
+                                        dst += n_ch;
+                                }
+                                src += n_ch;
+                        }
+                        for (int s = 0; s < scale; ++s) {
+                                if (!writer.write_row(row.data()))
+                                        return false;
+                        }
+                }
+        }
+
+        return writer.close();
+}
+
+bool stream_resize(const std::string& in, const std::string& out,
+                   int width, int height, int band_rows)
+{
+        if (!valid_band_rows(band_rows))
+                return false;
+
+        PnmReader reader;
+        if (!reader.open(in))
+                return false;
+
+        const int n_ch = reader.n_ch();
+        if (!valid_stream_size(width, height, n_ch)) {
+                fprintf(stderr, "Invalid output size %dx%d for %s\n", width, height, in.c_str());
+                return false;
+        }
+
+        PnmWriter writer;
+        if (!writer.open(out, width, height, n_ch))
+                return false;
+
+        ResizeAxis ax;
+        ResizeAxis ay;
+        ax.init(reader.w(), width);
+        ay.init(reader.h(), height);
+
+        // the last ay.max_taps horizontally resampled source rows are kept
+        // in a ring, source row y lives in ring row y % ay.max_taps
+        Image band(reader.w(), band_rows, n_ch);
+        Image ring(width, ay.max_taps, n_ch);
+        Image row(width, 1, n_ch);
+        std::vector<const uchar*> rows(ay.max_taps);
+        int n_done = 0;
+        int band_pos = 0;
+        int band_size = 0;
+        for (int i = 0; i < height; ++i) {
+                const int last = ay.start[i] + ay.n_taps[i];
+                while (n_done < last) {
+                        if (band_pos == band_size) {
+                                band_size = reader.read_band(&band);
+                                band_pos = 0;
+                                if (band_size == 0)
+                                        return false;
+                        }
+                        resize_row_horizontal(ax, band.data(band_pos++),
+                                              ring.data(n_done % ay.max_taps), n_ch);
+                        ++n_done;
+                }
+
+                for (int t = 0; t < ay.n_taps[i]; ++t)
+                        rows[t] = ring.data((ay.start[i] + t) % ay.max_taps);
+                resize_row_vertical(ay, i, &rows[0], row.data(), width*n_ch);
+                if (!writer.write_row(row.data()))
+                        return false;
+        }
+
+        return writer.close();
+}
+
+bool stream_scaleup_bilinear(const std::string& in, const std::string& out,
+                             int scale, int band_rows)
+{
+        PnmReader reader;
+        if (!reader.open(in))
+                return false;
+
+        if (scale < 1 || !valid_stream_size((long long) scale*reader.w(),
+                                            (long long) scale*reader.h(), reader.n_ch())) {
+                fprintf(stderr, "Invalid scale %d for %s\n", scale, in.c_str());
+                return false;
+        }
+        int width = scale*reader.w();
+        int height = scale*reader.h();
+        reader.close();
+
+        return stream_resize(in, out, width, height, band_rows);
+}
+
+}
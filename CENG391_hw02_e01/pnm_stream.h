@@ -0,0 +1,113 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef PNM_STREAM_H
+#define PNM_STREAM_H
+
+#include <cstdio>
+#include <string>
+
+#include "image.h"
+
+namespace ceng391 {
+
+// Sequential reader for binary PGM/PPM files that hands out the pixels in
+// bands of rows, so images larger than memory can be processed.
+class PnmReader {
+public:
+        PnmReader();
+        ~PnmReader();
+
+        bool open(const std::string& filename);
+        void close();
+
+        int w   () const { return m_width; }
+        int h   () const { return m_height; }
+        int n_ch() const { return m_n_channels; }
+        int rows_left() const { return m_height - m_row; }
+
+        // Reads up to n_rows rows into band starting at band row y0 and
+        // returns the number of rows read. band must be w() pixels wide
+        // with n_ch() channels.
+        int read_rows(Image* band, int y0, int n_rows);
+        int read_band(Image* band) { return read_rows(band, 0, band->h()); }
+private:
+        FILE* m_file;
+        int m_width;
+        int m_height;
+        int m_n_channels;
+        int m_row;
+};
+
+// Sequential writer producing a binary PGM/PPM file row by row.
+class PnmWriter {
+public:
+        PnmWriter();
+        ~PnmWriter();
+
+        bool open(const std::string& filename, int width, int height, int n_channels);
+        bool close();
+
+        bool write_row(const uchar* row);
+        bool write_rows(const Image* band, int y0, int n_rows);
+        int rows_left() const { return m_height - m_row; }
+private:
+        FILE* m_file;
+        int m_width;
+        int m_height;
+        int m_n_channels;
+        int m_row;
+};
+
+// An operation that only needs the rows of the band it is applied to.
+// y0 is the row of the full image stored in the first band row.
+class BandOp {
+public:
+        virtual ~BandOp() {}
+        virtual void apply(Image* band, int y0, int n_rows) = 0;
+};
+
+// Streams in to out through op, holding at most band_rows rows in memory.
+bool stream_bands(const std::string& in, const std::string& out, BandOp* op, int band_rows);
+
+bool stream_set_rect(const std::string& in, const std::string& out,
+                     int x, int y, int width, int height, uchar value, int band_rows);
+bool stream_transform(const std::string& in, const std::string& out,
+                      float alpha, int c, int band_rows);
+bool stream_scaleup_nn(const std::string& in, const std::string& out,
+                       int scale, int band_rows);
+bool stream_resize(const std::string& in, const std::string& out,
+                   int width, int height, int band_rows);
+bool stream_scaleup_bilinear(const std::string& in, const std::string& out,
+                             int scale, int band_rows);
+
+}
+
+#endif
@@ -0,0 +1,187 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "point_op.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CENG391_HAVE_AVX2_TARGET 1
+#endif
+
+namespace ceng391 {
+
+// Beyond this gain every nonzero pixel saturates whatever the bias, so
+// clamping to it changes no result and keeps x * gain within 64 bits.
+static const long long max_gain = 1LL << 40;
+
+PointOp::PointOp(float alpha, int c)
+{
+        double g = alpha * 256.0;
+        if (g != g)
+                g = 0.0;
+        if (g < -max_gain)
+                g = -max_gain;
+        else if (g > max_gain)
+                g = max_gain;
+        gain = (long long) (g < 0.0 ? g - 0.5 : g + 0.5);
+        bias = c;
+}
+
+// Negative products are rounded up so that bias - p truncates towards zero
+// like the float formula wherever the result is not clamped to 0.
+static inline uchar point_op_px(long long gain, int bias, uchar x)
+{
+        long long v = gain < 0 ? bias - ((x * -gain + 255) >> 8) : bias + ((x * gain) >> 8);
+        if (v < 0)
+                return 0;
+        if (v > 255)
+                return 255;
+        return (uchar) v;
+}
+
+static void point_op_row_scalar(const PointOp& op, const uchar* src, uchar* dst, size_t n)
+{
+        for (size_t i = 0; i < n; ++i)
+                dst[i] = point_op_px(op.gain, op.bias, src[i]);
+}
+
+// The SIMD paths multiply in unsigned 16 bit lanes and add the bias with
+// signed saturation. Below this gain the products stay under 32387, so a
+// bias clamped to [-32767, 32767] still saturates to the same bytes.
+static const int max_simd_gain = 32512;
+
+static bool simd_applies(const PointOp& op)
+{
+        return op.gain >= -max_simd_gain && op.gain <= max_simd_gain;
+}
+
+static short simd_bias(const PointOp& op)
+{
+        if (op.bias < -32767)
+                return -32767;
+        if (op.bias > 32767)
+                return 32767;
+        return (short) op.bias;
+}
+
+#if defined(__SSE2__)
+// Bytes are widened to x << 8 so that the unsigned high multiply yields
+// (x * |gain|) >> 8 directly, then added to or subtracted from the bias with
+// signed saturation and packed back with unsigned saturation. Negative gains
+// subtract one more where the low product bits are not zero.
+static size_t point_op_row_sse2(const PointOp& op, const uchar* src, uchar* dst, size_t n)
+{
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i one = _mm_set1_epi16(1);
+        const bool negative = op.gain < 0;
+        const __m128i gain = _mm_set1_epi16((short) (negative ? -op.gain : op.gain));
+        const __m128i bias = _mm_set1_epi16(simd_bias(op));
+
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+                __m128i x = _mm_loadu_si128((const __m128i*) (src + i));
+                __m128i xlo = _mm_unpacklo_epi8(zero, x);
+                __m128i xhi = _mm_unpackhi_epi8(zero, x);
+                __m128i lo = _mm_mulhi_epu16(xlo, gain);
+                __m128i hi = _mm_mulhi_epu16(xhi, gain);
+                if (negative) {
+                        __m128i exact_lo = _mm_cmpeq_epi16(_mm_mullo_epi16(xlo, gain), zero);
+                        __m128i exact_hi = _mm_cmpeq_epi16(_mm_mullo_epi16(xhi, gain), zero);
+                        lo = _mm_subs_epi16(_mm_subs_epi16(bias, lo), _mm_andnot_si128(exact_lo, one));
+                        hi = _mm_subs_epi16(_mm_subs_epi16(bias, hi), _mm_andnot_si128(exact_hi, one));
+                } else {
+                        lo = _mm_adds_epi16(bias, lo);
+                        hi = _mm_adds_epi16(bias, hi);
+                }
+                _mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(lo, hi));
+        }
+        return i;
+}
+#endif
+
+#if defined(CENG391_HAVE_AVX2_TARGET)
+__attribute__((target("avx2")))
+static size_t point_op_row_avx2(const PointOp& op, const uchar* src, uchar* dst, size_t n)
+{
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i one = _mm256_set1_epi16(1);
+        const bool negative = op.gain < 0;
+        const __m256i gain = _mm256_set1_epi16((short) (negative ? -op.gain : op.gain));
+        const __m256i bias = _mm256_set1_epi16(simd_bias(op));
+
+        // unpack and pack both work within 128 bit lanes so byte order
+        // is preserved end to end
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+                __m256i x = _mm256_loadu_si256((const __m256i*) (src + i));
+                __m256i xlo = _mm256_unpacklo_epi8(zero, x);
+                __m256i xhi = _mm256_unpackhi_epi8(zero, x);
+                __m256i lo = _mm256_mulhi_epu16(xlo, gain);
+                __m256i hi = _mm256_mulhi_epu16(xhi, gain);
+                if (negative) {
+                        __m256i exact_lo = _mm256_cmpeq_epi16(_mm256_mullo_epi16(xlo, gain), zero);
+                        __m256i exact_hi = _mm256_cmpeq_epi16(_mm256_mullo_epi16(xhi, gain), zero);
+                        lo = _mm256_subs_epi16(_mm256_subs_epi16(bias, lo), _mm256_andnot_si256(exact_lo, one));
+                        hi = _mm256_subs_epi16(_mm256_subs_epi16(bias, hi), _mm256_andnot_si256(exact_hi, one));
+                } else {
+                        lo = _mm256_adds_epi16(bias, lo);
+                        hi = _mm256_adds_epi16(bias, hi);
+                }
+                _mm256_storeu_si256((__m256i*) (dst + i), _mm256_packus_epi16(lo, hi));
+        }
+        return i;
+}
+
+static bool has_avx2()
+{
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+}
+#endif
+
+void point_op_row(const PointOp& op, const uchar* src, uchar* dst, size_t n)
+{
+        size_t i = 0;
+        if (simd_applies(op)) {
+#if defined(CENG391_HAVE_AVX2_TARGET)
+                if (has_avx2())
+                        i = point_op_row_avx2(op, src, dst, n);
+#endif
+#if defined(__SSE2__)
+                i += point_op_row_sse2(op, src + i, dst + i, n - i);
+#endif
+        }
+        point_op_row_scalar(op, src + i, dst + i, n - i);
+}
+
+}
@@ -0,0 +1,344 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "pyramid.h"
+#include "parallel.h"
+#include "resize.h"
+#include "trace.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::vector;
+
+namespace ceng391 {
+
+typedef unsigned short ushort;
+
+// Mirrors i into [0, n) without repeating the edge sample.
+static int reflect101(int i, int n)
+{
+        if (n == 1)
+                return 0;
+        while (i < 0 || i >= n) {
+                if (i < 0)
+                        i = -i;
+                if (i >= n)
+                        i = 2*n - 2 - i;
+        }
+        return i;
+}
+
+// Column sums r0 + 4 r1 + 6 r2 + 4 r3 + r4, at most 16*255.
+static void gaussian_rows(const uchar* const* r, ushort* dst, int row_size)
+{
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= row_size; i += 16) {
+                __m128i a[5][2];
+                for (int k = 0; k < 5; ++k) {
+                        __m128i v = _mm_loadu_si128((const __m128i*) (r[k] + i));
+                        a[k][0] = _mm_unpacklo_epi8(v, zero);
+                        a[k][1] = _mm_unpackhi_epi8(v, zero);
+                }
+                for (int j = 0; j < 2; ++j) {
+                        __m128i s = _mm_add_epi16(a[0][j], a[4][j]);
+                        __m128i n = _mm_add_epi16(a[1][j], a[3][j]);
+                        s = _mm_add_epi16(s, _mm_slli_epi16(n, 2));
+                        s = _mm_add_epi16(s, _mm_slli_epi16(a[2][j], 2));
+                        s = _mm_add_epi16(s, _mm_slli_epi16(a[2][j], 1));
+                        _mm_storeu_si128((__m128i*) (dst + i + 8*j), s);
+                }
+        }
+#endif
+        for (; i < row_size; ++i)
+                dst[i] = r[0][i] + 4*(r[1][i] + r[3][i]) + 6*r[2][i] + r[4][i];
+}
+
+// Horizontal [1 4 6 4 1] over the column sums at every pixel, src starts
+// two pixels left of the first output. Rounds the 256 scaled sums to bytes.
+static void gaussian_cols(const ushort* src, ushort* dst, int n, int n_ch)
+{
+        const int d = n_ch;
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128i round = _mm_set1_epi16(128);
+        for (; i + 8 <= n; i += 8) {
+                const ushort* s = src + i;
+                __m128i v0 = _mm_loadu_si128((const __m128i*) s);
+                __m128i v1 = _mm_loadu_si128((const __m128i*) (s + d));
+                __m128i v2 = _mm_loadu_si128((const __m128i*) (s + 2*d));
+                __m128i v3 = _mm_loadu_si128((const __m128i*) (s + 3*d));
+                __m128i v4 = _mm_loadu_si128((const __m128i*) (s + 4*d));
+                // wraps as unsigned, the largest sum 65280 + 128 still fits
+                __m128i h = _mm_add_epi16(_mm_add_epi16(v0, v4), round);
+                h = _mm_add_epi16(h, _mm_slli_epi16(_mm_add_epi16(v1, v3), 2));
+                h = _mm_add_epi16(h, _mm_slli_epi16(v2, 2));
+                h = _mm_add_epi16(h, _mm_slli_epi16(v2, 1));
+                _mm_storeu_si128((__m128i*) (dst + i), _mm_srli_epi16(h, 8));
+        }
+#endif
+        for (; i < n; ++i) {
+                const ushort* s = src + i;
+                unsigned h = s[0] + 4u*(s[d] + s[3*d]) + 6u*s[2*d] + s[4*d];
+                dst[i] = (h + 128) >> 8;
+        }
+}
+
+static void box_rows(const uchar* r0, const uchar* r1, ushort* dst, int row_size)
+{
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= row_size; i += 16) {
+                __m128i a = _mm_loadu_si128((const __m128i*) (r0 + i));
+                __m128i b = _mm_loadu_si128((const __m128i*) (r1 + i));
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                _mm_storeu_si128((__m128i*) (dst + i), lo);
+                _mm_storeu_si128((__m128i*) (dst + i + 8), hi);
+        }
+#endif
+        for (; i < row_size; ++i)
+                dst[i] = r0[i] + r1[i];
+}
+
+static void box_cols(const ushort* src, ushort* dst, int n, int n_ch)
+{
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128i round = _mm_set1_epi16(2);
+        for (; i + 8 <= n; i += 8) {
+                __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+                __m128i b = _mm_loadu_si128((const __m128i*) (src + i + n_ch));
+                __m128i h = _mm_add_epi16(_mm_add_epi16(a, b), round);
+                _mm_storeu_si128((__m128i*) (dst + i), _mm_srli_epi16(h, 2));
+        }
+#endif
+        for (; i < n; ++i)
+                dst[i] = (src[i] + src[i + n_ch] + 2) >> 2;
+}
+
+// Keeps the even pixels of a filtered row of 2*width pixels, the odd ones
+// are ignored.
+static void decimate_row(const ushort* src, uchar* dst, int width, int n_ch)
+{
+        int x = 0;
+#if defined(__SSE2__)
+        if (n_ch == 1) {
+                const __m128i even = _mm_set1_epi32(0xffff);
+                for (; x + 16 <= width; x += 16) {
+                        const ushort* s = src + 2*x;
+                        __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i*) s), even);
+                        __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i*) (s + 8)), even);
+                        __m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i*) (s + 16)), even);
+                        __m128i d = _mm_and_si128(_mm_loadu_si128((const __m128i*) (s + 24)), even);
+                        __m128i lo = _mm_packs_epi32(a, b);
+                        __m128i hi = _mm_packs_epi32(c, d);
+                        _mm_storeu_si128((__m128i*) (dst + x), _mm_packus_epi16(lo, hi));
+                }
+        } else if (n_ch == 4) {
+                for (; x + 4 <= width; x += 4) {
+                        const ushort* s = src + 8*x;
+                        __m128i a = _mm_loadu_si128((const __m128i*) s);
+                        __m128i b = _mm_loadu_si128((const __m128i*) (s + 8));
+                        __m128i c = _mm_loadu_si128((const __m128i*) (s + 16));
+                        __m128i d = _mm_loadu_si128((const __m128i*) (s + 24));
+                        __m128i p = _mm_packus_epi16(_mm_unpacklo_epi64(a, b),
+                                                     _mm_unpacklo_epi64(c, d));
+                        _mm_storeu_si128((__m128i*) (dst + 4*x), p);
+                }
+        }
+#endif
+        for (; x < width; ++x)
+                for (int c = 0; c < n_ch; ++c)
+                        dst[x*n_ch + c] = (uchar) src[2*x*n_ch + c];
+}
+
+static void pyr_down_gaussian(const ImageView& src, const ImageView& dst)
+{
+        const int n_ch = src.n_ch();
+        const int w = src.w();
+        const int h = src.h();
+        const int row_size = w*n_ch;
+        // only the even pixels are kept, the last odd one is never filtered
+        // as it may lie past the source
+        const int n_out = 2*dst.w()*n_ch;
+        const int n_filtered = n_out - n_ch;
+
+        parallel_for_rows(dst.h(), [&](int y0, int y1) {
+                vector<ushort> sums((size_t) (w + 4)*n_ch);
+                vector<ushort> filtered(n_out);
+                ushort* inner = &sums[2*n_ch];
+                for (int y = y0; y < y1; ++y) {
+                        const uchar* rows[5];
+                        for (int k = 0; k < 5; ++k)
+                                rows[k] = src.data(reflect101(2*y + k - 2, h));
+                        gaussian_rows(rows, inner, row_size);
+                        for (int p = 1; p <= 2; ++p) {
+                                int l = reflect101(-p, w);
+                                int r = reflect101(w - 1 + p, w);
+                                for (int c = 0; c < n_ch; ++c) {
+                                        inner[-p*n_ch + c] = inner[l*n_ch + c];
+                                        inner[(w - 1 + p)*n_ch + c] = inner[r*n_ch + c];
+                                }
+                        }
+                        gaussian_cols(&sums[0], &filtered[0], n_filtered, n_ch);
+                        decimate_row(&filtered[0], dst.data(y), dst.w(), n_ch);
+                }
+        });
+}
+
+static void pyr_down_box(const ImageView& src, const ImageView& dst)
+{
+        const int n_ch = src.n_ch();
+        const int w = src.w();
+        const int h = src.h();
+        const int row_size = w*n_ch;
+        const int n_out = 2*dst.w()*n_ch;
+        const int n_filtered = n_out - n_ch;
+
+        parallel_for_rows(dst.h(), [&](int y0, int y1) {
+                // one repeated pixel past the right edge for odd widths
+                vector<ushort> sums((size_t) (w + 1)*n_ch);
+                vector<ushort> filtered(n_out);
+                for (int y = y0; y < y1; ++y) {
+                        const uchar* r0 = src.data(2*y);
+                        const uchar* r1 = src.data(2*y + 1 < h ? 2*y + 1 : h - 1);
+                        box_rows(r0, r1, &sums[0], row_size);
+                        for (int c = 0; c < n_ch; ++c)
+                                sums[row_size + c] = sums[row_size - n_ch + c];
+                        box_cols(&sums[0], &filtered[0], n_filtered, n_ch);
+                        decimate_row(&filtered[0], dst.data(y), dst.w(), n_ch);
+                }
+        });
+}
+
+void pyr_down(const ImageView& src, const ImageView& dst, PyramidKernel kernel)
+{
+        TRACE_SCOPE("pyr_down");
+        if (src.w() <= 0 || src.h() <= 0 || src.n_ch() != dst.n_ch()
+            || dst.w() != (src.w() + 1)/2 || dst.h() != (src.h() + 1)/2)
+                return;
+
+        if (kernel == pyramid_box)
+                pyr_down_box(src, dst);
+        else
+                pyr_down_gaussian(src, dst);
+}
+
+Pyramid::Pyramid(const Image* src, PyramidKernel kernel)
+        : m_src(src), m_kernel(kernel), m_n_levels(1)
+{
+        int w = src->w();
+        int h = src->h();
+        while (w > 1 || h > 1) {
+                w = (w + 1)/2;
+                h = (h + 1)/2;
+                ++m_n_levels;
+        }
+        m_levels.assign(m_n_levels - 1, 0);
+}
+
+Pyramid::~Pyramid()
+{
+        invalidate();
+}
+
+ImageView Pyramid::level(int i)
+{
+        if (i <= 0 || i >= m_n_levels)
+                return i == 0 ? m_src->view() : ImageView();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int l = 1; l <= i; ++l) {
+                if (m_levels[l - 1])
+                        continue;
+                ImageView up = l == 1 ? m_src->view() : m_levels[l - 2]->view();
+                Image* down = new Image((up.w() + 1)/2, (up.h() + 1)/2, up.n_ch());
+                pyr_down(up, down->view(), m_kernel);
+                m_levels[l - 1] = down;
+        }
+        return m_levels[i - 1]->view();
+}
+
+int Pyramid::level_for_size(int width, int height) const
+{
+        int w = m_src->w();
+        int h = m_src->h();
+        int i = 0;
+        while (i + 1 < m_n_levels && (w + 1)/2 >= width && (h + 1)/2 >= height) {
+                w = (w + 1)/2;
+                h = (h + 1)/2;
+                ++i;
+        }
+        return i;
+}
+
+void Pyramid::resample(const ImageView& dst)
+{
+        TRACE_SCOPE("Pyramid::resample");
+        ImageView src = level(level_for_size(dst.w(), dst.h()));
+        if (src.w() != dst.w() || src.h() != dst.h()) {
+                ceng391::resample(src, dst);
+                return;
+        }
+
+        const int row_size = dst.w()*dst.n_ch();
+        parallel_for_rows(dst.h(), [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y)
+                        std::memcpy(dst.data(y), src.data(y), row_size);
+        });
+}
+
+void Pyramid::invalidate()
+{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_levels.size(); ++i) {
+                delete m_levels[i];
+                m_levels[i] = 0;
+        }
+}
+
+std::size_t Pyramid::size_bytes() const
+{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::size_t n = 0;
+        for (size_t i = 0; i < m_levels.size(); ++i)
+                if (m_levels[i])
+                        n += (std::size_t) m_levels[i]->step()*m_levels[i]->h();
+        return n;
+}
+
+}
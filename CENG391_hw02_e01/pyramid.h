@@ -0,0 +1,92 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <mutex>
+#include <vector>
+
+#include "image.h"
+
+namespace ceng391 {
+
+// Filters applied before dropping every other row and column.
+enum PyramidKernel {
+        // 5-tap binomial [1 4 6 4 1] / 16 in both directions, the usual
+        // Gaussian pyramid
+        pyramid_gaussian,
+        // mean of each 2x2 block, cheaper but aliases more
+        pyramid_box
+};
+
+// Halves src into dst, which must be (w + 1) / 2 x (h + 1) / 2 with the same
+// number of channels. The Gaussian mirrors the pixels past the borders and
+// the box repeats the last row and column of odd sized images.
+void pyr_down(const ImageView& src, const ImageView& dst, PyramidKernel kernel);
+
+// Successively halved copies of an image. Level 0 is the image itself and
+// level i is about 2^i times smaller, down to 1x1. Levels are computed from
+// the one above on first use and kept until invalidate(). The source image
+// must outlive the pyramid. Levels may be requested from several threads.
+class Pyramid {
+public:
+        explicit Pyramid(const Image* src, PyramidKernel kernel = pyramid_gaussian);
+        ~Pyramid();
+
+        int n_levels() const { return m_n_levels; }
+        PyramidKernel kernel() const { return m_kernel; }
+
+        ImageView level(int i);
+        // Smallest level that is still at least width x height, so a zoomed
+        // out view can be resampled from it instead of from level 0.
+        int level_for_size(int width, int height) const;
+        // Resamples the best level for its size into dst.
+        void resample(const ImageView& dst);
+
+        // Drops the computed levels, needed after the source pixels change.
+        void invalidate();
+        // Bytes held by the computed levels.
+        std::size_t size_bytes() const;
+private:
+        Pyramid(const Pyramid&);
+        Pyramid& operator=(const Pyramid&);
+
+        const Image* m_src;
+        PyramidKernel m_kernel;
+        int m_n_levels;
+        mutable std::mutex m_mutex;
+        // m_levels[i - 1] holds level i, null until computed
+        std::vector<Image*> m_levels;
+};
+
+}
+
+#endif
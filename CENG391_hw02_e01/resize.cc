@@ -0,0 +1,254 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "resize.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::vector;
+
+namespace ceng391 {
+
+static double triangle(double x)
+{
+        if (x < 0.0)
+                x = -x;
+        return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+void ResizeAxis::init(int in, int out)
+{
+        in_size = in;
+        out_size = out;
+
+        const double scale = (double) in / out;
+        const double filter_scale = scale > 1.0 ? scale : 1.0;
+        const double support = filter_scale;
+        const int one = 1 << weight_bits;
+
+        max_taps = 2*(int) std::ceil(support) + 1;
+        start.resize(out);
+        n_taps.resize(out);
+        weights.assign((size_t) out*max_taps, 0);
+
+        vector<double> k(max_taps);
+        for (int i = 0; i < out; ++i) {
+                double center = (i + 0.5)*scale;
+                int x0 = (int) std::floor(center - support + 0.5);
+                int x1 = (int) std::floor(center + support + 0.5);
+                if (x0 < 0)
+                        x0 = 0;
+                if (x1 > in)
+                        x1 = in;
+                if (x1 - x0 > max_taps)
+                        x1 = x0 + max_taps;
+
+                double total = 0.0;
+                for (int x = x0; x < x1; ++x) {
+                        k[x - x0] = triangle((x - center + 0.5) / filter_scale);
+                        total += k[x - x0];
+                }
+                // drop taps that do not contribute at either end
+                while (x1 - x0 > 1 && k[x1 - 1 - x0] == 0.0)
+                        --x1;
+                int skip = 0;
+                while (x1 - x0 - skip > 1 && k[skip] == 0.0)
+                        ++skip;
+
+                short* w = &weights[(size_t) i*max_taps];
+                int n = x1 - x0 - skip;
+                if (total <= 0.0) {
+                        n = 1;
+                        w[0] = one;
+                } else {
+                        // quantize so that the weights sum up to exactly one
+                        int sum = 0;
+                        int largest = 0;
+                        for (int t = 0; t < n; ++t) {
+                                w[t] = (short) std::floor(k[t + skip] / total * one + 0.5);
+                                sum += w[t];
+                                if (w[t] > w[largest])
+                                        largest = t;
+                        }
+                        w[largest] += one - sum;
+                }
+                start[i] = x0 + skip;
+                n_taps[i] = n;
+        }
+}
+
+template <int N>
+static void resize_row_horizontal_n(const ResizeAxis& ax, const uchar* src, uchar* dst)
+{
+        const int round = 1 << (ResizeAxis::weight_bits - 1);
+        for (int i = 0; i < ax.out_size; ++i) {
+                const uchar* p = src + ax.start[i]*N;
+                const short* w = &ax.weights[(size_t) i*ax.max_taps];
+                int acc[N];
+                for (int c = 0; c < N; ++c)
+                        acc[c] = round;
+                for (int t = 0; t < ax.n_taps[i]; ++t) {
+                        for (int c = 0; c < N; ++c)
+                                acc[c] += p[t*N + c]*w[t];
+                }
+                for (int c = 0; c < N; ++c) {
+                        int v = acc[c] >> ResizeAxis::weight_bits;
+                        dst[i*N + c] = v > 255 ? 255 : v;
+                }
+        }
+}
+
+static void resize_row_horizontal_any(const ResizeAxis& ax, const uchar* src, uchar* dst, int n_ch)
+{
+        const int round = 1 << (ResizeAxis::weight_bits - 1);
+        for (int i = 0; i < ax.out_size; ++i) {
+                const uchar* p = src + ax.start[i]*n_ch;
+                const short* w = &ax.weights[(size_t) i*ax.max_taps];
+                for (int c = 0; c < n_ch; ++c) {
+                        int acc = round;
+                        for (int t = 0; t < ax.n_taps[i]; ++t)
+                                acc += p[t*n_ch + c]*w[t];
+                        int v = acc >> ResizeAxis::weight_bits;
+                        dst[i*n_ch + c] = v > 255 ? 255 : v;
+                }
+        }
+}
+
+void resize_row_horizontal(const ResizeAxis& ax, const uchar* src, uchar* dst, int n_ch)
+{
+        switch (n_ch) {
+        case 1: resize_row_horizontal_n<1>(ax, src, dst); break;
+        case 3: resize_row_horizontal_n<3>(ax, src, dst); break;
+        case 4: resize_row_horizontal_n<4>(ax, src, dst); break;
+        default: resize_row_horizontal_any(ax, src, dst, n_ch); break;
+        }
+}
+
+void resize_row_vertical(const ResizeAxis& ay, int i, const uchar* const* rows,
+                         uchar* dst, int row_size)
+{
+        resize_rows_vertical(rows, &ay.weights[(size_t) i*ay.max_taps], ay.n_taps[i],
+                             dst, row_size);
+}
+
+void resize_rows_vertical(const uchar* const* rows, const short* w, int n,
+                          uchar* dst, int row_size)
+{
+        const int round = 1 << (ResizeAxis::weight_bits - 1);
+
+        int x = 0;
+#if defined(__SSE2__)
+        // two taps at a time: interleave the bytes of both rows as 16 bit
+        // pairs and multiply-add them with the matching pair of weights
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i vround = _mm_set1_epi32(round);
+        for (; x + 16 <= row_size; x += 16) {
+                __m128i acc0 = vround;
+                __m128i acc1 = vround;
+                __m128i acc2 = vround;
+                __m128i acc3 = vround;
+                for (int t = 0; t < n; t += 2) {
+                        __m128i a = _mm_loadu_si128((const __m128i*) (rows[t] + x));
+                        __m128i b;
+                        __m128i wt;
+                        if (t + 1 < n) {
+                                b = _mm_loadu_si128((const __m128i*) (rows[t + 1] + x));
+                                wt = _mm_set1_epi32((w[t] & 0xffff) | (w[t + 1] << 16));
+                        } else {
+                                b = zero;
+                                wt = _mm_set1_epi32(w[t] & 0xffff);
+                        }
+                        __m128i lo = _mm_unpacklo_epi8(a, b);
+                        __m128i hi = _mm_unpackhi_epi8(a, b);
+                        __m128i p0 = _mm_unpacklo_epi8(lo, zero);
+                        __m128i p1 = _mm_unpackhi_epi8(lo, zero);
+                        __m128i p2 = _mm_unpacklo_epi8(hi, zero);
+                        __m128i p3 = _mm_unpackhi_epi8(hi, zero);
+                        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(p0, wt));
+                        acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(p1, wt));
+                        acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(p2, wt));
+                        acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(p3, wt));
+                }
+                acc0 = _mm_srai_epi32(acc0, ResizeAxis::weight_bits);
+                acc1 = _mm_srai_epi32(acc1, ResizeAxis::weight_bits);
+                acc2 = _mm_srai_epi32(acc2, ResizeAxis::weight_bits);
+                acc3 = _mm_srai_epi32(acc3, ResizeAxis::weight_bits);
+                __m128i v0 = _mm_packs_epi32(acc0, acc1);
+                __m128i v1 = _mm_packs_epi32(acc2, acc3);
+                _mm_storeu_si128((__m128i*) (dst + x), _mm_packus_epi16(v0, v1));
+        }
+#endif
+        for (; x < row_size; ++x) {
+                int acc = round;
+                for (int t = 0; t < n; ++t)
+                        acc += rows[t][x]*w[t];
+                int v = acc >> ResizeAxis::weight_bits;
+                dst[x] = v > 255 ? 255 : v;
+        }
+}
+
+void resample(const ImageView& src, const ImageView& dst)
+{
+        TRACE_SCOPE("resample");
+        if (dst.w() <= 0 || dst.h() <= 0 || src.w() <= 0 || src.h() <= 0)
+                return;
+
+        const int n_ch = src.n_ch();
+        ResizeAxis ax;
+        ResizeAxis ay;
+        ax.init(src.w(), dst.w());
+        ay.init(src.h(), dst.h());
+
+        // horizontal pass over the source rows the vertical taps touch
+        const int y0 = ay.start[0];
+        const int y1 = ay.start[dst.h() - 1] + ay.n_taps[dst.h() - 1];
+        Image tmp(dst.w(), y1 - y0, n_ch);
+        parallel_for_rows(y1 - y0, [&](int r0, int r1) {
+                for (int y = y0 + r0; y < y0 + r1; ++y)
+                        resize_row_horizontal(ax, src.data(y), tmp.data(y - y0), n_ch);
+        });
+
+        parallel_for_rows(dst.h(), [&](int i0, int i1) {
+                vector<const uchar*> rows(ay.max_taps);
+                for (int i = i0; i < i1; ++i) {
+                        for (int t = 0; t < ay.n_taps[i]; ++t)
+                                rows[t] = tmp.data(ay.start[i] + t - y0);
+                        resize_row_vertical(ay, i, &rows[0], dst.data(i), dst.w()*n_ch);
+                }
+        });
+}
+
+}
@@ -0,0 +1,77 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#include <vector>
+
+#include "image.h"
+
+namespace ceng391 {
+
+// Filter taps of a separable resize along one axis. Output sample i is the
+// weighted sum of input samples start[i] .. start[i] + n_taps[i] - 1 with the
+// weights stored at weights[i*max_taps] in 2.14 fixed point. The taps come
+// from a triangle filter that is widened by the scale factor when
+// downscaling, so this is bilinear interpolation for upscaling and an
+// antialiased linear filter for downscaling.
+struct ResizeAxis {
+        static const int weight_bits = 14;
+
+        void init(int in_size, int out_size);
+
+        int in_size;
+        int out_size;
+        int max_taps;
+        std::vector<int> start;
+        std::vector<int> n_taps;
+        std::vector<short> weights;
+};
+
+// Horizontal pass over one row with n_ch interleaved channels.
+void resize_row_horizontal(const ResizeAxis& ax, const uchar* src, uchar* dst, int n_ch);
+
+// Vertical pass producing output row i from rows[k], k < ay.n_taps[i], which
+// hold input rows ay.start[i] + k. row_size is the row length in bytes.
+void resize_row_vertical(const ResizeAxis& ay, int i, const uchar* const* rows,
+                         uchar* dst, int row_size);
+
+// Weighted sum of n_taps rows with 2.14 fixed point weights.
+void resize_rows_vertical(const uchar* const* rows, const short* weights, int n_taps,
+                          uchar* dst, int row_size);
+
+// Resamples src to the size of dst. Both views must have the same number
+// of channels.
+void resample(const ImageView& src, const ImageView& dst);
+
+}
+
+#endif
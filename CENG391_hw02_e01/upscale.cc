@@ -0,0 +1,276 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "upscale.h"
+#include "parallel.h"
+#include "resize.h"
+#include "trace.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::memcpy;
+
+namespace ceng391 {
+
+// Repeats every pixel of a row Scale times.
+template <int Scale, int N>
+static void widen_row(const uchar* src, uchar* dst, int width)
+{
+        for (int x = 0; x < width; ++x) {
+                for (int s = 0; s < Scale; ++s) {
+                        for (int c = 0; c < N; ++c)
+                                dst[s*N + c] = src[c];
+                }
+                src += N;
+                dst += Scale*N;
+        }
+}
+
+// Gray rows with a power of two factor are widened by unpacking a vector
+// with itself, every unpack doubles the pixels. Other factors widen no
+// pixels here and leave the row to widen_row().
+template <int Scale, bool PowerOfTwo = (Scale & (Scale - 1)) == 0>
+struct WidenGray {
+        static int run(const uchar*, uchar*, int) { return 0; }
+};
+
+#if defined(__SSE2__)
+template <int Scale>
+struct WidenGray<Scale, true> {
+        static int run(const uchar* src, uchar* dst, int width)
+        {
+                int x = 0;
+                for (; x + 16 <= width; x += 16) {
+                        __m128i v[Scale];
+                        v[0] = _mm_loadu_si128((const __m128i*) (src + x));
+                        for (int n = 1; n < Scale; n *= 2) {
+                                for (int t = n - 1; t >= 0; --t) {
+                                        v[2*t + 1] = _mm_unpackhi_epi8(v[t], v[t]);
+                                        v[2*t] = _mm_unpacklo_epi8(v[t], v[t]);
+                                }
+                        }
+                        for (int t = 0; t < Scale; ++t)
+                                _mm_storeu_si128((__m128i*) (dst + Scale*x + 16*t), v[t]);
+                }
+                return x;
+        }
+};
+#endif
+
+template <int Scale, int N>
+static void widen_row_fast(const uchar* src, uchar* dst, int width)
+{
+        int x = 0;
+        if (N == 1)
+                x = WidenGray<Scale>::run(src, dst, width);
+        widen_row<Scale, N>(src + x*N, dst + x*Scale*N, width - x);
+}
+
+template <int Scale, int N>
+static void upscale_nn_fixed(const ImageView& src, const ImageView& dst)
+{
+        const size_t row_size = (size_t) dst.w()*N;
+        parallel_for_rows(src.h(), [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y) {
+                        uchar* first = dst.data(y*Scale);
+                        widen_row_fast<Scale, N>(src.data(y), first, src.w());
+                        for (int s = 1; s < Scale; ++s)
+                                memcpy(dst.data(y*Scale + s), first, row_size);
+                }
+        });
+}
+
+static void upscale_nn_any(const ImageView& src, const ImageView& dst, int scale)
+{
+        const int n_ch = src.n_ch();
+        const size_t row_size = (size_t) dst.w()*n_ch;
+        parallel_for_rows(src.h(), [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y) {
+                        const uchar* s = src.data(y);
+                        uchar* first = dst.data(y*scale);
+                        uchar* d = first;
+                        for (int x = 0; x < src.w(); ++x) {
+                                for (int k = 0; k < scale; ++k) {
+                                        memcpy(d, s, n_ch);
+                                        d += n_ch;
+                                }
+                                s += n_ch;
+                        }
+                        for (int k = 1; k < scale; ++k)
+                                memcpy(dst.data(y*scale + k), first, row_size);
+                }
+        });
+}
+
+template <int Scale>
+static void upscale_nn_dispatch(const ImageView& src, const ImageView& dst)
+{
+        switch (src.n_ch()) {
+        case 1: upscale_nn_fixed<Scale, 1>(src, dst); break;
+        case 3: upscale_nn_fixed<Scale, 3>(src, dst); break;
+        case 4: upscale_nn_fixed<Scale, 4>(src, dst); break;
+        default: upscale_nn_any(src, dst, Scale); break;
+        }
+}
+
+void upscale_nn(const ImageView& src, const ImageView& dst, int scale)
+{
+        TRACE_SCOPE("upscale_nn");
+        switch (scale) {
+        case 2: upscale_nn_dispatch<2>(src, dst); break;
+        case 3: upscale_nn_dispatch<3>(src, dst); break;
+        case 4: upscale_nn_dispatch<4>(src, dst); break;
+        case 8: upscale_nn_dispatch<8>(src, dst); break;
+        default: upscale_nn_any(src, dst, scale); break;
+        }
+}
+
+// Output sample j*Scale + k lies at (k + 0.5)/Scale - 0.5 relative to input
+// sample j. Phases left of the sample blend j - 1 and j, the others j and
+// j + 1. The weights are the quantized triangle filter weights of the resize
+// engine, computed exactly in integers.
+template <int Scale>
+struct BilinearPhases {
+        static constexpr int one = 1 << ResizeAxis::weight_bits;
+
+        // distance to the left neighbour in units of 1/(2*Scale)
+        static constexpr int num(int k) { return 2*k + 1 < Scale ? Scale - 2*k - 1 : 2*k + 1 - Scale; }
+        static constexpr bool left(int k) { return 2*k + 1 < Scale; }
+        // weight of the farther sample, round half up like the engine
+        static constexpr short far(int k) { return (short) ((2*num(k)*one + 2*Scale) / (4*Scale)); }
+        static constexpr short near(int k) { return (short) (one - far(k)); }
+        // weights of the first and second tap
+        static constexpr short w0(int k) { return left(k) ? far(k) : near(k); }
+        static constexpr short w1(int k) { return left(k) ? near(k) : far(k); }
+};
+
+template <int Scale, int N>
+static void upscale_row_bilinear(const uchar* padded, uchar* dst, int width)
+{
+        typedef BilinearPhases<Scale> P;
+        const int round = 1 << (ResizeAxis::weight_bits - 1);
+        // padded[N*(j + 1)] is input sample j, the row is extended by one
+        // replicated pixel on both sides
+        for (int j = 0; j < width; ++j) {
+                const uchar* p = padded + N*j;
+                for (int k = 0; k < Scale; ++k) {
+                        const uchar* a = P::left(k) ? p : p + N;
+                        for (int c = 0; c < N; ++c) {
+                                int v = (a[c]*P::w0(k) + a[N + c]*P::w1(k) + round) >> ResizeAxis::weight_bits;
+                                dst[c] = (uchar) v;
+                        }
+                        dst += N;
+                }
+        }
+}
+
+// Upscales the source rows [y0, y1). Every band keeps its own ring of
+// horizontally upscaled rows so bands can run on different threads.
+template <int Scale, int N>
+static void upscale_bilinear_band(const ImageView& src, const ImageView& dst,
+                                  int y0, int y1)
+{
+        typedef BilinearPhases<Scale> P;
+        const int w = src.w();
+        const int h = src.h();
+        const int row_size = dst.w()*N;
+
+        Image padded(w + 2, 1, N);
+        Image horizontal(dst.w(), 3, N);
+        int n_done = y0 > 0 ? y0 - 1 : 0;
+
+        for (int y = y0; y < y1; ++y) {
+                // horizontally upscaled rows y - 1 .. y + 1 (clamped) are
+                // kept in a ring indexed by row % 3
+                int last = y + 1 < h ? y + 1 : h - 1;
+                for (; n_done <= last; ++n_done) {
+                        uchar* pad = padded.data();
+                        memcpy(pad + N, src.data(n_done), (size_t) w*N);
+                        memcpy(pad, pad + N, N);
+                        memcpy(pad + N*(w + 1), pad + N*w, N);
+                        upscale_row_bilinear<Scale, N>(pad, horizontal.data(n_done % 3), w);
+                }
+
+                const uchar* above = horizontal.data((y > 0 ? y - 1 : 0) % 3);
+                const uchar* center = horizontal.data(y % 3);
+                const uchar* below = horizontal.data(last % 3);
+                for (int k = 0; k < Scale; ++k) {
+                        const uchar* rows[2];
+                        rows[0] = P::left(k) ? above : center;
+                        rows[1] = P::left(k) ? center : below;
+                        const short weights[2] = { P::w0(k), P::w1(k) };
+                        resize_rows_vertical(rows, weights, 2, dst.data(y*Scale + k), row_size);
+                }
+        }
+}
+
+template <int Scale, int N>
+static void upscale_bilinear_fixed(const ImageView& src, const ImageView& dst)
+{
+        // bands overlap by one horizontally upscaled row, so keep them tall
+        int chunk = chunk_rows();
+        if (chunk == 0) {
+                chunk = src.h() / (4*num_threads());
+                if (chunk < 16)
+                        chunk = 16;
+        }
+        parallel_for_rows(src.h(), [&](int y0, int y1) {
+                upscale_bilinear_band<Scale, N>(src, dst, y0, y1);
+        }, chunk);
+}
+
+template <int Scale>
+static void upscale_bilinear_dispatch(const ImageView& src, const ImageView& dst)
+{
+        switch (src.n_ch()) {
+        case 1: upscale_bilinear_fixed<Scale, 1>(src, dst); break;
+        case 3: upscale_bilinear_fixed<Scale, 3>(src, dst); break;
+        case 4: upscale_bilinear_fixed<Scale, 4>(src, dst); break;
+        default: resample(src, dst); break;
+        }
+}
+
+void upscale_bilinear(const ImageView& src, const ImageView& dst, int scale)
+{
+        TRACE_SCOPE("upscale_bilinear");
+        switch (scale) {
+        case 2: upscale_bilinear_dispatch<2>(src, dst); break;
+        case 3: upscale_bilinear_dispatch<3>(src, dst); break;
+        case 4: upscale_bilinear_dispatch<4>(src, dst); break;
+        case 8: upscale_bilinear_dispatch<8>(src, dst); break;
+        default: resample(src, dst); break;
+        }
+}
+
+}
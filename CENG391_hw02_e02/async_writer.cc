@@ -0,0 +1,113 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "async_writer.h"
+
+namespace ceng391 {
+
+AsyncPnmWriter::AsyncPnmWriter(int max_queued)
+{
+        m_max_queued = max_queued < 1 ? 1 : max_queued;
+        m_busy = false;
+        m_quit = false;
+        m_failed = false;
+        m_thread = std::thread(&AsyncPnmWriter::run, this);
+}
+
+AsyncPnmWriter::~AsyncPnmWriter()
+{
+        flush();
+        {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_quit = true;
+        }
+        m_not_empty.notify_one();
+        m_thread.join();
+}
+
+void AsyncPnmWriter::submit(Image* img, const std::string& filename, const Done& done)
+{
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while ((int) m_queue.size() >= m_max_queued)
+                m_not_full.wait(lock);
+
+        Job job;
+        job.img = img;
+        job.filename = filename;
+        job.done = done;
+        m_queue.push_back(job);
+        m_not_empty.notify_one();
+}
+
+bool AsyncPnmWriter::flush()
+{
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_queue.empty() || m_busy)
+                m_idle.wait(lock);
+
+        bool ok = !m_failed;
+        m_failed = false;
+
+        return ok;
+}
+
+void AsyncPnmWriter::run()
+{
+        for (;;) {
+                Job job;
+                {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        while (m_queue.empty() && !m_quit)
+                                m_not_empty.wait(lock);
+                        if (m_queue.empty())
+                                return;
+
+                        job = m_queue.front();
+                        m_queue.pop_front();
+                        m_busy = true;
+                }
+                m_not_full.notify_one();
+
+                bool ok = job.img->write_pnm(job.filename);
+                delete job.img;
+                if (job.done)
+                        job.done(ok);
+
+                {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_busy = false;
+                        if (!ok)
+                                m_failed = true;
+                }
+                m_idle.notify_all();
+        }
+}
+
+}
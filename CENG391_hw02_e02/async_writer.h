@@ -0,0 +1,87 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "image.h"
+
+namespace ceng391 {
+
+// Writes images to disk on a background thread so that the caller can
+// continue with the next image. At most max_queued images are waiting at any
+// time, submit() blocks once the queue is full.
+class AsyncPnmWriter {
+public:
+        explicit AsyncPnmWriter(int max_queued = 4);
+        ~AsyncPnmWriter();
+
+        // Called on the writer thread with the result of the write, after
+        // the image has been deleted.
+        typedef std::function<void(bool ok)> Done;
+
+        // Takes ownership of img, which is deleted once it has been saved
+        // with Image::write_pnm(filename).
+        void submit(Image* img, const std::string& filename, const Done& done = Done());
+
+        // Waits until every submitted image has been written and returns
+        // false if any of the writes failed since the last flush.
+        bool flush();
+private:
+        struct Job {
+                Image* img;
+                std::string filename;
+                Done done;
+        };
+
+        void run();
+
+        std::mutex m_mutex;
+        std::condition_variable m_not_empty;
+        std::condition_variable m_not_full;
+        std::condition_variable m_idle;
+        std::deque<Job> m_queue;
+        int m_max_queued;
+        bool m_busy;
+        bool m_quit;
+        bool m_failed;
+        std::thread m_thread;
+};
+
+}
+
+#endif
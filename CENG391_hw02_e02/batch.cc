@@ -0,0 +1,566 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "async_writer.h"
+#include "image.h"
+#include "point_op.h"
+#include "resize.h"
+#include "rotate.h"
+#include "trace.h"
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using ceng391::Image;
+using ceng391::ImageView;
+using ceng391::uchar;
+
+typedef std::chrono::steady_clock Clock;
+
+static void usage()
+{
+        cerr << "Usage: image-batch [options] -o OUT_DIR INPUT...\n"
+             << "\n"
+             << "INPUT is a PNM file or a directory whose .pgm, .ppm and .pnm files\n"
+             << "are processed. The operations are applied in the order given. The\n"
+             << "results are named after the inputs without their extension, so the\n"
+             << "input names must differ in more than the directory or extension.\n"
+             << "\n"
+             << "Options:\n"
+             << "  -o DIR              write the results to DIR\n"
+             << "  -l FILE             read more inputs from FILE, one per line, - for stdin\n"
+             << "  -j N                process N files at a time (default: number of cores)\n"
+             << "  -m MB               limit the pixels in flight to MB megabytes (default 512)\n"
+             << "  -q                  only print the totals\n"
+             << "\n"
+             << "Operations:\n"
+             << "  --scale F | WxH     resize by a factor or to a size\n"
+             << "  --rotate DEG        rotate clockwise onto the full canvas\n"
+             << "  --transform A,C     brightness/contrast, pixel * A + C\n"
+             << "  --rect X,Y,W,H,V    fill a rectangle with V\n"
+             << "  --gray              convert to gray\n"
+             << "  --rgb               convert to rgb\n"
+             << "  --planar            store the channels as separate planes, the\n"
+             << "                      steps that need interleaved pixels convert back\n";
+}
+
+enum OpKind { op_scale, op_rotate, op_transform, op_rect, op_gray, op_rgb, op_planar };
+
+struct Op {
+        OpKind kind;
+        double a;  // scale factor, angle or alpha
+        int v[5];  // scale size, bias or rectangle and value
+};
+
+struct Shape {
+        int w;
+        int h;
+        int n_ch;
+
+        size_t bytes() const { return (size_t) w*h*n_ch; }
+};
+
+static bool parse_op(const string& name, const char* arg, Op* op)
+{
+        std::memset(op, 0, sizeof(*op));
+        if (name == "--gray") {
+                op->kind = op_gray;
+                return true;
+        }
+        if (name == "--rgb") {
+                op->kind = op_rgb;
+                return true;
+        }
+        if (name == "--planar") {
+                op->kind = op_planar;
+                return true;
+        }
+        if (!arg)
+                return false;
+
+        if (name == "--scale") {
+                op->kind = op_scale;
+                if (std::sscanf(arg, "%dx%d", &op->v[0], &op->v[1]) == 2)
+                        return op->v[0] > 0 && op->v[1] > 0;
+                op->a = std::atof(arg);
+                return op->a > 0.0;
+        }
+        if (name == "--rotate") {
+                op->kind = op_rotate;
+                op->a = std::atof(arg);
+                return true;
+        }
+        if (name == "--transform") {
+                op->kind = op_transform;
+                return std::sscanf(arg, "%lf,%d", &op->a, &op->v[0]) == 2;
+        }
+        if (name == "--rect") {
+                op->kind = op_rect;
+                return std::sscanf(arg, "%d,%d,%d,%d,%d", &op->v[0], &op->v[1],
+                                   &op->v[2], &op->v[3], &op->v[4]) == 5;
+        }
+        return false;
+}
+
+static bool takes_argument(const string& name)
+{
+        return name != "--gray" && name != "--rgb" && name != "--planar";
+}
+
+// Layouts the kernel of an operation works on. The image is only converted
+// when its layout is not one of them.
+enum { accepts_interleaved = 1, accepts_planar = 2 };
+
+static int op_layouts(const Op& op)
+{
+        switch (op.kind) {
+        case op_rotate:
+                // one source position serves all channels of a pixel
+                return accepts_interleaved;
+        default:
+                return accepts_interleaved | accepts_planar;
+        }
+}
+
+static Shape output_shape(const Op& op, const Shape& in)
+{
+        Shape out = in;
+        switch (op.kind) {
+        case op_scale:
+                if (op.v[0] > 0) {
+                        out.w = op.v[0];
+                        out.h = op.v[1];
+                } else {
+                        out.w = std::max(1, (int) (in.w*op.a + 0.5));
+                        out.h = std::max(1, (int) (in.h*op.a + 0.5));
+                }
+                break;
+        case op_rotate:
+                if (std::fmod(op.a, 90.0) == 0.0) {
+                        if (((int) op.a / 90) % 2 != 0)
+                                std::swap(out.w, out.h);
+                } else {
+                        ceng391::Transform t = ceng391::rotation_about_center(op.a, in.w, in.h, 0, 0);
+                        ceng391::Canvas c = ceng391::warp_bounds(t, in.w, in.h);
+                        out.w = c.w;
+                        out.h = c.h;
+                }
+                break;
+        case op_gray:
+                out.n_ch = 1;
+                break;
+        case op_rgb:
+                out.n_ch = 3;
+                break;
+        default:
+                break;
+        }
+        return out;
+}
+
+static Image* to_gray(const Image* img)
+{
+        Image* gray = Image::new_gray(img->w(), img->h());
+        if (img->is_planar()) {
+                for (int y = 0; y < img->h(); ++y) {
+                        const uchar* r = img->plane(0).data(y);
+                        const uchar* g = img->plane(1).data(y);
+                        const uchar* b = img->plane(2).data(y);
+                        uchar* d = gray->data(y);
+                        for (int x = 0; x < img->w(); ++x)
+                                d[x] = (uchar) ((77*r[x] + 150*g[x] + 29*b[x] + 128) >> 8);
+                }
+                return gray;
+        }
+        for (int y = 0; y < img->h(); ++y) {
+                const uchar* s = img->data(y);
+                uchar* d = gray->data(y);
+                for (int x = 0; x < img->w(); ++x, s += 3)
+                        d[x] = (uchar) ((77*s[0] + 150*s[1] + 29*s[2] + 128) >> 8);
+        }
+        return gray;
+}
+
+static Image* to_rgb(const Image* img)
+{
+        Image* rgb = Image::new_rgb(img->w(), img->h());
+        for (int y = 0; y < img->h(); ++y) {
+                const uchar* s = img->data(y);
+                uchar* d = rgb->data(y);
+                for (int x = 0; x < img->w(); ++x, d += 3)
+                        d[0] = d[1] = d[2] = s[x];
+        }
+        return rgb;
+}
+
+// Applies op to img and returns the result, which may be img itself. img is
+// deleted when a new image is returned.
+static Image* apply_op(Image* img, const Op& op)
+{
+        TRACE_SCOPE("batch op");
+        if (!(op_layouts(op) & (img->is_planar() ? accepts_planar : accepts_interleaved)))
+                img->set_layout(ceng391::layout_interleaved);
+
+        Image* out = img;
+        Shape shape = { img->w(), img->h(), img->n_ch() };
+        switch (op.kind) {
+        case op_scale: {
+                Shape s = output_shape(op, shape);
+                if (img->is_planar()) {
+                        out = Image::new_planar(s.w, s.h, s.n_ch);
+                        for (int c = 0; c < s.n_ch; ++c)
+                                ceng391::resample(img->plane(c), out->plane(c));
+                } else {
+                        out = new Image(s.w, s.h, s.n_ch);
+                        ceng391::resample(img->view(), out->view());
+                }
+                break;
+        }
+        case op_rotate:
+                out = Image::rotate_full_bilinear(img->view(), (float) op.a);
+                break;
+        case op_transform: {
+                // every sample is mapped the same, planes or pixels
+                ceng391::PointOp p((float) op.a, op.v[0]);
+                const ImageView v = img->view();
+                for (int y = 0; y < v.h(); ++y)
+                        ceng391::point_op_row(p, v.data(y), v.data(y), v.w()*v.n_ch());
+                break;
+        }
+        case op_rect:
+                img->set_rect(op.v[0], op.v[1], op.v[2], op.v[3], (uchar) op.v[4]);
+                break;
+        case op_gray:
+                if (img->n_ch() == 3)
+                        out = to_gray(img);
+                break;
+        case op_rgb:
+                if (img->n_ch() == 1)
+                        out = to_rgb(img);
+                break;
+        case op_planar:
+                img->set_layout(ceng391::layout_planar);
+                break;
+        }
+
+        if (out != img)
+                delete img;
+        return out;
+}
+
+// Bytes that are allocated at most at the same time while running the chain,
+// the input and output of the largest step.
+static size_t chain_footprint(const vector<Op>& ops, Shape shape)
+{
+        size_t peak = shape.bytes();
+        for (size_t i = 0; i < ops.size(); ++i) {
+                Shape out = output_shape(ops[i], shape);
+                peak = std::max(peak, shape.bytes() + out.bytes());
+                shape = out;
+        }
+        return peak;
+}
+
+// Counts the bytes of the images being processed and blocks new ones while
+// the budget is used up. A file larger than the whole budget still runs, but
+// only on its own.
+class MemoryBudget {
+public:
+        explicit MemoryBudget(size_t limit) : m_limit(limit), m_used(0), m_peak(0) {}
+
+        void acquire(size_t bytes)
+        {
+                TRACE_SCOPE("MemoryBudget::acquire");
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while (m_used != 0 && m_used + bytes > m_limit)
+                        m_released.wait(lock);
+                m_used += bytes;
+                m_peak = std::max(m_peak, m_used);
+        }
+
+        void release(size_t bytes)
+        {
+                {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_used -= bytes;
+                }
+                m_released.notify_all();
+        }
+
+        size_t peak() const { return m_peak; }
+private:
+        std::mutex m_mutex;
+        std::condition_variable m_released;
+        size_t m_limit;
+        size_t m_used;
+        size_t m_peak;
+};
+
+static bool has_pnm_extension(const string& name)
+{
+        size_t dot = name.rfind('.');
+        if (dot == string::npos)
+                return false;
+        string ext = name.substr(dot);
+        return ext == ".pgm" || ext == ".ppm" || ext == ".pnm";
+}
+
+static bool add_input(const string& path, vector<string>* inputs)
+{
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+                cerr << "Could not find " << path << endl;
+                return false;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+                inputs->push_back(path);
+                return true;
+        }
+
+        DIR* dir = opendir(path.c_str());
+        if (!dir) {
+                cerr << "Could not open directory " << path << endl;
+                return false;
+        }
+        vector<string> files;
+        while (struct dirent* entry = readdir(dir)) {
+                string name = entry->d_name;
+                if (has_pnm_extension(name))
+                        files.push_back(path + "/" + name);
+        }
+        closedir(dir);
+
+        std::sort(files.begin(), files.end());
+        inputs->insert(inputs->end(), files.begin(), files.end());
+        return true;
+}
+
+static bool add_list(const string& list, vector<string>* inputs)
+{
+        std::ifstream file;
+        std::istream* in = &std::cin;
+        if (list != "-") {
+                file.open(list.c_str());
+                if (!file) {
+                        cerr << "Could not open list " << list << endl;
+                        return false;
+                }
+                in = &file;
+        }
+
+        string line;
+        while (std::getline(*in, line)) {
+                if (!line.empty() && !add_input(line, inputs))
+                        return false;
+        }
+        return true;
+}
+
+// Output name without the extension, write_pnm() adds the right one.
+static string output_name(const string& out_dir, const string& input)
+{
+        size_t slash = input.rfind('/');
+        string name = slash == string::npos ? input : input.substr(slash + 1);
+        size_t dot = name.rfind('.');
+        if (dot != string::npos)
+                name = name.substr(0, dot);
+        return out_dir + "/" + name;
+}
+
+static double elapsed_ms(Clock::time_point start)
+{
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+        vector<string> inputs;
+        vector<Op> ops;
+        string out_dir;
+        int n_jobs = (int) std::thread::hardware_concurrency();
+        double budget_mb = 512.0;
+        bool quiet = false;
+
+        for (int i = 1; i < argc; ++i) {
+                string arg = argv[i];
+                const char* next = i + 1 < argc ? argv[i + 1] : 0;
+                if (arg == "-h" || arg == "--help") {
+                        usage();
+                        return EXIT_SUCCESS;
+                } else if (arg == "-o" && next) {
+                        out_dir = argv[++i];
+                } else if (arg == "-l" && next) {
+                        if (!add_list(argv[++i], &inputs))
+                                return EXIT_FAILURE;
+                } else if (arg == "-j" && next) {
+                        n_jobs = std::atoi(argv[++i]);
+                } else if (arg == "-m" && next) {
+                        budget_mb = std::atof(argv[++i]);
+                } else if (arg == "-q") {
+                        quiet = true;
+                } else if (arg.compare(0, 2, "--") == 0) {
+                        Op op;
+                        if (!parse_op(arg, next, &op)) {
+                                cerr << "Invalid operation " << arg << endl;
+                                return EXIT_FAILURE;
+                        }
+                        if (takes_argument(arg))
+                                ++i;
+                        ops.push_back(op);
+                } else if (arg[0] == '-') {
+                        usage();
+                        return EXIT_FAILURE;
+                } else if (!add_input(arg, &inputs)) {
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (out_dir.empty() || inputs.empty()) {
+                usage();
+                return EXIT_FAILURE;
+        }
+        // two inputs with the same name would be written to the same file,
+        // possibly by two workers at once
+        vector<string> outputs(inputs.size());
+        std::map<string, size_t> output_input;
+        for (size_t k = 0; k < inputs.size(); ++k) {
+                outputs[k] = output_name(out_dir, inputs[k]);
+                std::pair<std::map<string, size_t>::iterator, bool> added =
+                        output_input.insert(std::make_pair(outputs[k], k));
+                if (!added.second) {
+                        cerr << inputs[added.first->second] << " and " << inputs[k]
+                             << " would both be written to " << outputs[k] << endl;
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (n_jobs < 1)
+                n_jobs = 1;
+        n_jobs = std::min(n_jobs, (int) inputs.size());
+
+        MemoryBudget budget((size_t) (budget_mb*1024*1024));
+        std::atomic<size_t> next_input(0);
+        std::mutex report_mutex;
+        int n_done = 0;
+        int n_failed = 0;
+        double total_mpix = 0.0;
+        const Clock::time_point start = Clock::now();
+
+        // Files run concurrently, so the operations inside a file run on the
+        // calling worker whenever the shared row pool is busy.
+        // Prints the result of one file, failed when error is not empty.
+        auto report = [&](size_t k, const Shape& in, const Shape& out,
+                          Clock::time_point file_start, const string& error) {
+                const double ms = elapsed_ms(file_start);
+                const double mpix = in.w*(double) in.h/1e6;
+                std::lock_guard<std::mutex> lock(report_mutex);
+                if (!error.empty()) {
+                        cerr << inputs[k] << ": " << error << endl;
+                        ++n_failed;
+                        return;
+                }
+                ++n_done;
+                total_mpix += mpix;
+                if (!quiet)
+                        std::printf("%s %dx%dx%d -> %dx%dx%d %.2f ms %.1f MPix/s\n",
+                                    inputs[k].c_str(), in.w, in.h, in.n_ch,
+                                    out.w, out.h, out.n_ch, ms, mpix/ms*1e3);
+        };
+
+        auto work = [&]() {
+                // writes the result of a file while the next one is
+                // processed, the budget covers a file until it is written
+                ceng391::AsyncPnmWriter writer(1);
+                for (size_t k = next_input++; k < inputs.size(); k = next_input++) {
+                        const string& input = inputs[k];
+                        const Clock::time_point file_start = Clock::now();
+
+                        // load_pnm() maps the file, the pixels are only
+                        // loaded when touched
+                        string error;
+                        Image* img = Image::load_pnm(input, &error);
+                        if (!img) {
+                                std::lock_guard<std::mutex> lock(report_mutex);
+                                cerr << error << endl;
+                                ++n_failed;
+                                continue;
+                        }
+
+                        const Shape in = { img->w(), img->h(), img->n_ch() };
+                        const size_t footprint = chain_footprint(ops, in);
+                        budget.acquire(footprint);
+
+                        TRACE_SCOPE("batch file");
+                        for (size_t i = 0; i < ops.size(); ++i)
+                                img = apply_op(img, ops[i]);
+
+                        const Shape out = { img->w(), img->h(), img->n_ch() };
+                        writer.submit(img, outputs[k], [&, k, in, out, footprint, file_start](bool ok) {
+                                budget.release(footprint);
+                                report(k, in, out, file_start, ok ? "" : "could not write");
+                        });
+                }
+        };
+
+        vector<std::thread> workers;
+        for (int i = 1; i < n_jobs; ++i)
+                workers.push_back(std::thread(work));
+        work();
+        for (size_t i = 0; i < workers.size(); ++i)
+                workers[i].join();
+
+        const double seconds = elapsed_ms(start)/1e3;
+        std::printf("%d files, %d failed, %.1f MPix in %.3f s: %.1f MPix/s, %.1f files/s, "
+                    "%d jobs, peak %.1f MB in flight\n",
+                    n_done, n_failed, total_mpix, seconds, total_mpix/seconds,
+                    n_done/seconds, n_jobs, budget.peak()/(1024.0*1024.0));
+
+        return n_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,256 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "bench.h"
+#include "perf_counters.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#ifndef IMAGES_DIR
+#define IMAGES_DIR "../Images"
+#endif
+
+using std::cerr;
+using std::string;
+using std::vector;
+
+namespace ceng391 {
+
+BenchOptions::BenchOptions()
+        : min_time(0.2), min_runs(5), format("table"), max_mb(1024.0), images(IMAGES_DIR),
+          counters(false)
+{
+        sizes.push_back(256);
+        sizes.push_back(1024);
+        sizes.push_back(4096);
+        sizes.push_back(16384);
+}
+
+static void usage(const char* name)
+{
+        cerr << "Usage: " << name << " [options]\n"
+             << "  --sizes N,N,...   sides of the synthetic images (default 256,1024,4096,16384)\n"
+             << "  --min-time S      run every case for at least S seconds (default 0.2)\n"
+             << "  --runs N          run every case at least N times (default 5)\n"
+             << "  --format F        table, csv or json (default table)\n"
+             << "  --filter TEXT     only run operations whose name contains TEXT\n"
+             << "  --max-mb MB       skip cases that need more memory (default 1024)\n"
+             << "  --images DIR      directory with house.pgm and house.ppm\n"
+             << "  --counters        report IPC and cache/branch misses per pixel\n";
+}
+
+bool BenchOptions::parse(int argc, char** argv)
+{
+        for (int i = 1; i < argc; ++i) {
+                string arg = argv[i];
+                if (arg == "--counters") {
+                        counters = true;
+                        continue;
+                }
+                if (i + 1 >= argc || arg == "--help") {
+                        usage(argv[0]);
+                        return false;
+                }
+
+                string value = argv[++i];
+                if (arg == "--sizes") {
+                        sizes.clear();
+                        std::istringstream in(value);
+                        string side;
+                        while (std::getline(in, side, ','))
+                                if (std::atoi(side.c_str()) > 0)
+                                        sizes.push_back(std::atoi(side.c_str()));
+                } else if (arg == "--min-time") {
+                        min_time = std::atof(value.c_str());
+                } else if (arg == "--runs") {
+                        min_runs = std::atoi(value.c_str());
+                } else if (arg == "--format" && (value == "table" || value == "csv" || value == "json")) {
+                        format = value;
+                } else if (arg == "--filter") {
+                        filter = value;
+                } else if (arg == "--max-mb") {
+                        max_mb = std::atof(value.c_str());
+                } else if (arg == "--images") {
+                        images = value;
+                } else {
+                        usage(argv[0]);
+                        return false;
+                }
+        }
+        if (min_runs < 1)
+                min_runs = 1;
+        return true;
+}
+
+Bench::Bench(const BenchOptions& options)
+        : m_options(options), m_counters(0), m_printed_header(false)
+{
+        // opened before any case runs, so thread pool workers started by
+        // the cases are counted too
+        if (m_options.counters) {
+                m_counters = new PerfCounters();
+                if (!m_counters->available()) {
+                        cerr << "[WARNING][CENG391::Bench] Hardware counters are not available ("
+                             << m_counters->error() << "), reporting times only\n";
+                        delete m_counters;
+                        m_counters = 0;
+                }
+        }
+}
+
+Bench::~Bench()
+{
+        delete m_counters;
+}
+
+bool Bench::enabled(const string& op, double megabytes) const
+{
+        if (!m_options.filter.empty() && op.find(m_options.filter) == string::npos)
+                return false;
+        return megabytes <= m_options.max_mb;
+}
+
+void Bench::print_header()
+{
+        if (m_options.format == "table") {
+                std::printf("%-24s %-10s %11s %2s %5s %10s %10s %6s %9s %8s",
+                            "op", "input", "size", "ch", "runs", "mean_ms",
+                            "min_ms", "cv_%", "mpix_s", "ns_px");
+                if (m_counters)
+                        std::printf(" %5s %8s %8s", "ipc", "llc_px", "brm_px");
+        } else if (m_options.format == "csv") {
+                std::printf("op,input,width,height,channels,runs,mean_ms,min_ms,"
+                            "stddev_ms,mpix_s,ns_per_pixel");
+                if (m_counters)
+                        std::printf(",ipc,llc_misses_per_pixel,branch_misses_per_pixel");
+        }
+        if (m_options.format != "json")
+                std::printf("\n");
+        m_printed_header = true;
+}
+
+// Formats a counter statistic for the table, csv or json output, unknown
+// values are "-", empty or null.
+static string format_stat(double value, const string& format, const char* spec)
+{
+        if (value < 0.0)
+                return format == "table" ? "-" : format == "csv" ? "" : "null";
+        char s[32];
+        std::snprintf(s, sizeof(s), spec, value);
+        return s;
+}
+
+void Bench::run(const string& op, const string& input, int width, int height,
+                int n_ch, double n_pixels, const std::function<void()>& body)
+{
+        typedef std::chrono::steady_clock Clock;
+
+        body();
+
+        if (m_counters)
+                m_counters->start();
+        vector<double> times;
+        double total = 0.0;
+        while ((int) times.size() < m_options.min_runs || total < m_options.min_time) {
+                Clock::time_point start = Clock::now();
+                body();
+                double t = std::chrono::duration<double>(Clock::now() - start).count();
+                times.push_back(t);
+                total += t;
+        }
+        PerfSample counts;
+        if (m_counters)
+                counts = m_counters->stop();
+
+        const double n = times.size();
+        double min = times[0];
+        double var = 0.0;
+        for (size_t i = 0; i < times.size(); ++i) {
+                if (times[i] < min)
+                        min = times[i];
+        }
+        const double mean = total/n;
+        for (size_t i = 0; i < times.size(); ++i)
+                var += (times[i] - mean)*(times[i] - mean);
+        const double stddev = n > 1 ? std::sqrt(var/(n - 1)) : 0.0;
+        const double mpix_s = n_pixels/mean/1e6;
+        const double ns_px = mean*1e9/n_pixels;
+        const double n_counted = n*n_pixels;
+        const double ipc = counts.ipc();
+        const double llc_px = counts.has(perf_llc_misses) ? counts.count[perf_llc_misses]/n_counted : -1.0;
+        const double brm_px = counts.has(perf_branch_misses) ? counts.count[perf_branch_misses]/n_counted : -1.0;
+        const string& f = m_options.format;
+
+        if (!m_printed_header)
+                print_header();
+
+        if (m_options.format == "table") {
+                char size[32];
+                std::snprintf(size, sizeof(size), "%dx%d", width, height);
+                std::printf("%-24s %-10s %11s %2d %5d %10.3f %10.3f %6.1f %9.1f %8.3f",
+                            op.c_str(), input.c_str(), size, n_ch, (int) n, mean*1e3,
+                            min*1e3, 100.0*stddev/mean, mpix_s, ns_px);
+                if (m_counters)
+                        std::printf(" %5s %8s %8s", format_stat(ipc, f, "%.2f").c_str(),
+                                    format_stat(llc_px, f, "%.4f").c_str(),
+                                    format_stat(brm_px, f, "%.4f").c_str());
+                std::printf("\n");
+        } else if (m_options.format == "csv") {
+                std::printf("%s,%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.3f,%.4f",
+                            op.c_str(), input.c_str(), width, height, n_ch, (int) n,
+                            mean*1e3, min*1e3, stddev*1e3, mpix_s, ns_px);
+                if (m_counters)
+                        std::printf(",%s,%s,%s", format_stat(ipc, f, "%.3f").c_str(),
+                                    format_stat(llc_px, f, "%.6f").c_str(),
+                                    format_stat(brm_px, f, "%.6f").c_str());
+                std::printf("\n");
+        } else {
+                std::printf("{\"op\": \"%s\", \"input\": \"%s\", \"width\": %d, \"height\": %d, "
+                            "\"channels\": %d, \"runs\": %d, \"mean_ms\": %.6f, \"min_ms\": %.6f, "
+                            "\"stddev_ms\": %.6f, \"mpix_s\": %.3f, \"ns_per_pixel\": %.4f, ",
+                            op.c_str(), input.c_str(), width, height, n_ch, (int) n,
+                            mean*1e3, min*1e3, stddev*1e3, mpix_s, ns_px);
+                if (m_counters)
+                        std::printf("\"ipc\": %s, \"llc_misses_per_pixel\": %s, "
+                                    "\"branch_misses_per_pixel\": %s, ",
+                                    format_stat(ipc, f, "%.3f").c_str(),
+                                    format_stat(llc_px, f, "%.6f").c_str(),
+                                    format_stat(brm_px, f, "%.6f").c_str());
+                std::printf("\"compiler\": \"%s\"}\n", __VERSION__);
+        }
+        std::fflush(stdout);
+}
+
+}
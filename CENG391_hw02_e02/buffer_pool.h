@@ -0,0 +1,100 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "util.h"
+
+namespace ceng391 {
+
+// Size-class cache for pixel buffers. Released buffers are kept on a free
+// list of their size class and handed out again to the next request of that
+// class, so per-frame temporaries do not go back to malloc. Classes grow in
+// quarter steps between powers of two, wasting at most a quarter of a block.
+// Buffers are 64 byte aligned and the pool is safe to use from any thread.
+class BufferPool {
+public:
+        static const std::size_t alignment = 64;
+
+        struct Stats {
+                std::size_t block_size;
+                std::size_t hits;
+                std::size_t misses;
+                std::size_t in_use;
+                std::size_t cached;
+        };
+
+        static BufferPool& instance();
+
+        BufferPool();
+        ~BufferPool();
+
+        uchar* acquire(std::size_t size);
+        void release(uchar* buffer);
+
+        // Frees cached buffers until at most max_cached bytes are kept.
+        void trim(std::size_t max_cached = 0);
+        // Buffers released while the cache holds more than max_cached bytes
+        // are freed right away.
+        void set_max_cached(std::size_t max_cached);
+        std::size_t cached_bytes() const;
+
+        // Statistics of the size classes that have been used so far.
+        std::vector<Stats> stats() const;
+        void print_stats(std::ostream& out) const;
+private:
+        struct SizeClass {
+                std::size_t block_size;
+                std::vector<uchar*> free_list;
+                std::size_t hits;
+                std::size_t misses;
+                std::size_t in_use;
+        };
+
+        BufferPool(const BufferPool&);
+        BufferPool& operator=(const BufferPool&);
+
+        int find_class(std::size_t size) const;
+
+        mutable std::mutex m_mutex;
+        std::vector<SizeClass> m_classes;
+        std::size_t m_cached_bytes;
+        std::size_t m_max_cached;
+};
+
+}
+
+#endif
@@ -29,43 +29,124 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // ------------------------------
 #include "image.h"
+#include "buffer_pool.h"
+#include "layout.h"
+#include "orient.h"
+#include "rotate.h"
+#include "trace.h"
 
 #include <iostream>
-#include <fstream>
+#include <cerrno>
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
-using std::ofstream;
-using std::ios;
 using std::cerr;
 using std::string;
-using std::fopen;
-using std::fputc;
 using std::exit;
-using std::fclose;
-using std::fscanf;
-using std::fread;
 
 const double pi = std::acos(-1);
 
 namespace ceng391 {
 
-Image::Image(int width, int height, int n_channels, int step)
+static int round_up(int value, int align)
+{
+        return (value + align - 1) / align * align;
+}
+
+Image::Image(int width, int height, int n_channels, int step, int border)
 {
         m_width = width;
         m_height = height;
         m_n_channels = n_channels;
+        m_border = border > 0 ? border : 0;
+        m_layout = layout_interleaved;
+
+        int left = m_border > 0 ? round_up(m_border*m_n_channels, row_align) : 0;
+        int min_step = left + (m_width + m_border)*m_n_channels;
+        if (step < 0)
+                m_step = round_up(min_step, row_align);
+        else
+                m_step = min_step < step ? step : min_step;
+
+        size_t size = (size_t) m_step*(m_height + 2*m_border);
+        m_buffer = allocate_pixels(size);
+        if (m_border > 0)
+                memset(m_buffer, 0, size);
+        m_data = m_buffer + (size_t) m_border*m_step + left;
+        m_mapped_size = 0;
+}
 
-        m_step = m_width*m_n_channels;
-        if (m_step < step)
-                m_step = step;
-        m_data = new uchar[m_step*height];
+Image::Image()
+{
+        m_width = 0;
+        m_height = 0;
+        m_n_channels = 0;
+        m_step = 0;
+        m_border = 0;
+        m_layout = layout_interleaved;
+        m_data = 0;
+        m_buffer = 0;
+        m_mapped_size = 0;
 }
 
 Image::~Image()
 {
-        delete [] m_data;
+        release_data();
+}
+
+int Image::aligned_step(int width, int n_channels)
+{
+        return round_up(width*n_channels, row_align);
+}
+
+uchar* Image::allocate_pixels(size_t size)
+{
+        return BufferPool::instance().acquire(size);
+}
+
+void Image::free_pixels(uchar* pixels)
+{
+        BufferPool::instance().release(pixels);
+}
+
+void Image::release_data()
+{
+        if (m_mapped_size != 0)
+                munmap(m_buffer, m_mapped_size);
+        else
+                free_pixels(m_buffer);
+
+        m_data = 0;
+        m_buffer = 0;
+        m_mapped_size = 0;
+}
+
+void Image::take_data(Image* other)
+{
+        release_data();
+        m_width = other->m_width;
+        m_height = other->m_height;
+        m_n_channels = other->m_n_channels;
+        m_step = other->m_step;
+        m_border = other->m_border;
+        m_layout = other->m_layout;
+        m_data = other->m_data;
+        m_buffer = other->m_buffer;
+        m_mapped_size = other->m_mapped_size;
+
+        other->m_data = 0;
+        other->m_buffer = 0;
+        other->m_mapped_size = 0;
+        delete other;
 }
 
 Image* Image::new_gray(int width, int height)
@@ -78,8 +159,61 @@ Image* Image::new_rgb(int width, int height)
         return new Image(width, height, 3);
 }
 
+Image* Image::new_planar(int width, int height, int n_channels)
+{
+        Image* img = new Image(width, height*n_channels, 1);
+        img->m_height = height;
+        img->m_n_channels = n_channels;
+        img->m_layout = layout_planar;
+        return img;
+}
+
+ImageView Image::view() const
+{
+        if (is_planar())
+                return ImageView(m_data, m_width, m_height*m_n_channels, 1, m_step, m_n_channels);
+        return ImageView(m_data, m_width, m_height, m_n_channels, m_step);
+}
+
+ImageView Image::plane(int c) const
+{
+        if (is_planar() && c >= 0 && c < m_n_channels)
+                return ImageView(m_data + (std::ptrdiff_t) c*m_height*m_step, m_width, m_height, 1, m_step);
+        if (m_n_channels == 1 && c == 0)
+                return view();
+        return ImageView();
+}
+
+void Image::set_layout(Layout layout)
+{
+        if (layout == m_layout)
+                return;
+        if (m_n_channels == 1) {
+                m_layout = layout;
+                return;
+        }
+
+        Image* converted = layout == layout_planar ? new_planar(m_width, m_height, m_n_channels)
+                                                   : new Image(m_width, m_height, m_n_channels);
+        convert_layout(*this, converted);
+        take_data(converted);
+}
+
 void Image::set_rect(int x, int y, int width, int height, uchar value)
 {
+        if (!is_planar()) {
+                view().set_rect(x, y, width, height, value);
+                return;
+        }
+        for (int c = 0; c < m_n_channels; ++c)
+                plane(c).set_rect(x, y, width, height, value);
+}
+
+ImageView ImageView::sub(int x, int y, int width, int height) const
+{
+        if (m_n_planes > 1)
+                return ImageView();
+
         if (x < 0) {
                 width += x;
                 x = 0;
@@ -90,131 +224,165 @@ void Image::set_rect(int x, int y, int width, int height, uchar value)
                 y = 0;
         }
 
-        for (int j = y; j < y+height; ++j) {
-                if (j >= m_height)
-                        break;
-                uchar* row_data = data(j);
-                for (int i = x; i < x+width; ++i) {
-                        if (i >= m_width)
-                                break;
-                        for (int c = 0; c < m_n_channels; ++c)
-                                row_data[i*m_n_channels + c] = value;
-                }
-        }
+        if (x > m_width)
+                x = m_width;
+        if (y > m_height)
+                y = m_height;
+        if (width > m_width - x)
+                width = m_width - x;
+        if (height > m_height - y)
+                height = m_height - y;
+        if (width < 0)
+                width = 0;
+        if (height < 0)
+                height = 0;
+
+        return ImageView(data(y) + x*m_n_channels, width, height, m_n_channels, m_step);
+}
+
+void ImageView::set_rect(int x, int y, int width, int height, uchar value) const
+{
+        TRACE_SCOPE("set_rect");
+        ImageView r = sub(x, y, width, height);
+        const size_t row_size = (size_t) r.m_width*m_n_channels;
+        for (int j = 0; j < r.m_height; ++j)
+                memset(r.data(j), value, row_size);
 }
 
 uchar* Image::rotate_bilinear(float angle) {
-    
-        int height = m_height;
-        int width = m_width;
-        int step = width;
+        set_layout(layout_interleaved);
+        take_data(rotate_bilinear(view(), angle));
+        return m_data;
+}
 
-        uchar* rotatedImage = new uchar[step * height];
+uchar* Image::rotate_full_bilinear(float angle) {
+        set_layout(layout_interleaved);
+        take_data(rotate_full_bilinear(view(), angle));
+        return m_data;
+}
 
-        // intialize the image
-        for(int i = 0; i < height; i++) {
-                for(int j = 0; j < width; j++) {
-                        rotatedImage[step * i + j] = 150;
+// The pixels of a view as interleaved samples: the view itself, or a copy of
+// it for the stacked planes of a planar image.
+class InterleavedPixels {
+public:
+        explicit InterleavedPixels(const ImageView& src) : m_copy(0), m_view(src) {
+                int n_planes = src.n_planes();
+                if (n_planes <= 1)
+                        return;
+
+                int height = src.h() / n_planes;
+                m_copy = new Image(src.w(), height, n_planes);
+                m_view = m_copy->view();
+                std::vector<const uchar*> planes(n_planes);
+                for (int y = 0; y < height; ++y) {
+                        for (int c = 0; c < n_planes; ++c)
+                                planes[c] = src.data(c*height + y);
+                        interleave_row(&planes[0], m_view.data(y), src.w(), n_planes);
                 }
         }
+        ~InterleavedPixels() { delete m_copy; }
 
-        // define center
-        int center[] = { height / 2, width / 2};
-             
-        for(int i = 0; i < height; i++) {
-                for(int j = 0; j < width; j++) {
-                        // move center
-                        float* cord = new float[2];
-                        cord[0] = i - center[0];
-                        cord[1] = j - center[1];
-
-                        // multiply by inverse of rotation matrix
-                        rotate_cord(angle, cord, 1);
-                        // move center
-                        float rotatedX = cord[0] + center[0];
-                        float rotatedY = cord[1] + center[1];
-
-                        // assign intensity value to destination
-                        if(rotatedX < m_height && rotatedY < m_width) {
-                               int intensity = interpolate_bilinear(rotatedX, rotatedY);
-                               rotatedImage[step * i + j] = intensity;
-                        }
+        const ImageView& view() const { return m_view; }
 
-                        delete cord;                        
-                }
-        }
+private:
+        InterleavedPixels(const InterleavedPixels&);
+        InterleavedPixels& operator=(const InterleavedPixels&);
 
-        m_height = height;
-        m_width = width;
-        m_step = step;
+        Image* m_copy;
+        ImageView m_view;
+};
 
-        delete m_data;
-        m_data = rotatedImage;
+Image* Image::rotate_bilinear(const ImageView& src, float angle) {
+        if (src.n_planes() > 1)
+                return rotate_bilinear(InterleavedPixels(src).view(), angle);
+        Image* rotated = new Image(src.w(), src.h(), src.n_ch());
+        rotate(src, rotated->view(), angle);
 
-        return rotatedImage;
+        return rotated;
 }
 
-uchar* Image::rotate_full_bilinear(float angle) { 
-        float** window = new float*[4];
-        calculate_window_size(angle, window);
-        
-        int height = abs(window[0][0] - window[3][0]);
-        int width = abs(window[1][1] - window[2][1]);
-        int step = width;
+Image* Image::rotate_full_bilinear(const ImageView& src, float angle) {
+        if (src.n_planes() > 1)
+                return rotate_full_bilinear(InterleavedPixels(src).view(), angle);
+        // right angles are pixel permutations, no window or resampling;
+        // reduced first so that the cast cannot overflow
+        if (std::fmod(angle, 90.0f) == 0.0f)
+                return rotate_right_angle(src, (int) std::fmod(angle, 360.0f));
 
-        for(int i = 0; i < 4; i++) {
-                delete window[i];
-        }
-        delete window;
+        Transform t = rotation_about_center(angle, src.w(), src.h(), 0, 0);
+        Canvas c = warp_bounds(t, src.w(), src.h());
+        Image* rotated = new Image(c.w, c.h, src.n_ch());
+        ceng391::warp(src, rotated->view(), t, c.x, c.y, rotate_background);
 
-        uchar* rotatedImage = new uchar[step * height];
+        return rotated;
+}
 
-        // intialize the image
-        for(int i = 0; i < height; i++) {
-                for(int j = 0; j < width; j++) {
-                        rotatedImage[step * i + j] = 150;
-                }
-        }
+uchar* Image::warp(const Transform& t) {
+        set_layout(layout_interleaved);
+        take_data(warp(view(), t));
+        return m_data;
+}
 
-        // define center
-        int center[] = { height / 2, width / 2};
-             
-        for(int i = 0; i < height; i++) {
-                for(int j = 0; j < width; j++) {
-                        // move center
-                        float* cord = new float[2];
-                        cord[0] = i - center[0];
-                        cord[1] = j - center[1];
-
-                        // multiply by inverse of rotation matrix
-                        rotate_cord(angle, cord, 1);
-                        // move center
-                     
-                        float rotatedX = cord[0] + center[0];
-                        float rotatedY = cord[1] + center[1];
-                        
-                        if(rotatedX < 0) {
-                                rotatedX = height + rotatedX;
-                        }
-                 
-                        // assign intensity value to destination
-                        if(rotatedX < m_height && rotatedY < m_width) {
-                               int intensity = interpolate_bilinear(rotatedX, rotatedY);
-                               rotatedImage[step * i + j] = intensity;
-                        }
+Image* Image::warp(const ImageView& src, const Transform& t) {
+        if (src.n_planes() > 1)
+                return warp(InterleavedPixels(src).view(), t);
+        Canvas c = warp_bounds(t, src.w(), src.h());
+        Image* warped = new Image(c.w, c.h, src.n_ch());
+        ceng391::warp(src, warped->view(), t, c.x, c.y);
 
-                        delete cord;                        
-                }
-        }
+        return warped;
+}
 
-        m_height = height;
-        m_width = width;
-        m_step = step;
+uchar* Image::rotate_right_angle(int angle) {
+        set_layout(layout_interleaved);
+        take_data(rotate_right_angle(view(), angle));
+        return m_data;
+}
 
-        delete m_data;
-        m_data = rotatedImage;
+uchar* Image::transpose() {
+        set_layout(layout_interleaved);
+        take_data(transpose(view()));
+        return m_data;
+}
 
-        return rotatedImage;
+uchar* Image::flip_horizontal() {
+        set_layout(layout_interleaved);
+        take_data(flip_horizontal(view()));
+        return m_data;
+}
+
+uchar* Image::flip_vertical() {
+        set_layout(layout_interleaved);
+        take_data(flip_vertical(view()));
+        return m_data;
+}
+
+static Image* new_reoriented(const ImageView& src, Orientation o) {
+        if (src.n_planes() > 1)
+                return new_reoriented(InterleavedPixels(src).view(), o);
+        Image* dst = swaps_axes(o) ? new Image(src.h(), src.w(), src.n_ch())
+                                   : new Image(src.w(), src.h(), src.n_ch());
+        reorient(src, dst->view(), o);
+
+        return dst;
+}
+
+Image* Image::rotate_right_angle(const ImageView& src, int angle) {
+        if (angle % 90 != 0)
+                return rotate_full_bilinear(src, (float) angle);
+        return new_reoriented(src, right_angle_orientation(angle));
+}
+
+Image* Image::transpose(const ImageView& src) {
+        return new_reoriented(src, orientation_transpose);
+}
+
+Image* Image::flip_horizontal(const ImageView& src) {
+        return new_reoriented(src, orientation_flip_horizontal);
+}
+
+Image* Image::flip_vertical(const ImageView& src) {
+        return new_reoriented(src, orientation_flip_vertical);
 }
 
 void Image::rotate_cord(float angle, float *cord, int flag = 1) {
@@ -230,33 +398,33 @@ void Image::rotate_cord(float angle, float *cord, int flag = 1) {
 }
 
 void Image::calculate_window_size(float angle, float** window) {
+        calculate_window_size(m_height, m_width, angle, window);
+}
+
+void Image::calculate_window_size(int src_height, int src_width, float angle, float** window) {
+        // corners relative to the center the rotation turns about
+        const int center[] = { src_height / 2, src_width / 2 };
+
         float* topLeft = new float[2];
-        topLeft[0] = 0 - 347;
-        topLeft[1] = 0 - 512;        
+        topLeft[0] = 0 - center[0];
+        topLeft[1] = 0 - center[1];
         rotate_cord(angle, topLeft, -1);
         
         float* bottomRight = new float[2];
-        bottomRight[0] = m_height - 347;
-        bottomRight[1] = m_width - 512;
+        bottomRight[0] = src_height - center[0];
+        bottomRight[1] = src_width - center[1];
         rotate_cord(angle, bottomRight, -1);
 
-        int height = abs(topLeft[0] - bottomRight[0]);
-        cerr<<height<<std::endl;
-       
         float* topRight = new float[2];
-        topRight[0] = 0 - 347;
-        topRight[1] = m_width - 512;
+        topRight[0] = 0 - center[0];
+        topRight[1] = src_width - center[1];
         rotate_cord(angle, topRight, -1);
 
         float* bottomLeft = new float[2];
-        bottomLeft[0] = m_height - 347;
-        bottomLeft[1] = 0 - 512;
+        bottomLeft[0] = src_height - center[0];
+        bottomLeft[1] = 0 - center[1];
         rotate_cord(angle, bottomLeft, -1);
 
-        int width = abs(topRight[1] - bottomLeft[1]);
-        cerr<<width<<std::endl;
-      
-
         window[0] = topLeft;
         window[1] = topRight;
         window[2] = bottomLeft;
@@ -264,107 +432,240 @@ void Image::calculate_window_size(float angle, float** window) {
 
 }
 
-int Image::interpolate_bilinear(float rotatedX, float rotatedY ) {
-     
+int Image::interpolate_bilinear(float rotatedX, float rotatedY, int channel) {
+        if (is_planar())
+                return interpolate_bilinear(plane(channel), rotatedX, rotatedY);
+        return interpolate_bilinear(view(), rotatedX, rotatedY, channel);
+}
+
+int Image::interpolate_bilinear(const ImageView& src, float rotatedX, float rotatedY, int channel) {
+        if (src.n_planes() > 1) {
+                int height = src.h() / src.n_planes();
+                ImageView plane(src.data(channel*height), src.w(), height, 1, src.step());
+                return interpolate_bilinear(plane, rotatedX, rotatedY);
+        }
+        const uchar* src_data = src.data() + channel;
+        int src_step = src.step();
+        int n_ch = src.n_ch();
+
         int x = (int) rotatedX;
         int y = (int) rotatedY;
                  
         float alpha = rotatedX - x;
         float beta = rotatedY - y;
              
-        int intensity =   (1 - alpha) * (1 - beta) * m_data[m_step * x + y]
-                        + alpha       * (1 - beta) * m_data[m_step * (x + 1) + y]
-                        + (1 - alpha) * beta       * m_data[m_step * x + y + 1]
-                        + alpha       * beta       * m_data[m_step * (x + 1) + y + 1];
+        int intensity =   (1 - alpha) * (1 - beta) * src_data[src_step * x + y * n_ch]
+                        + alpha       * (1 - beta) * src_data[src_step * (x + 1) + y * n_ch]
+                        + (1 - alpha) * beta       * src_data[src_step * x + (y + 1) * n_ch]
+                        + alpha       * beta       * src_data[src_step * (x + 1) + (y + 1) * n_ch];
              
 
    
         return intensity;
 }
 
+static bool writev_all(int fd, struct iovec* iov, int n_iov)
+{
+        while (n_iov > 0) {
+                ssize_t n = writev(fd, iov, n_iov);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return false;
+                }
+                while (n_iov > 0 && (size_t) n >= iov->iov_len) {
+                        n -= iov->iov_len;
+                        ++iov;
+                        --n_iov;
+                }
+                if (n_iov > 0) {
+                        iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                        iov->iov_len -= n;
+                }
+        }
+        return true;
+}
+
 bool Image::write_pnm(const std::string& filename) const
 {
-        if (m_n_channels != 1) {
-                cerr << "[ERROR][CENG391::Image] Currently only grayscale images can be saved as PNM files!\n";
+        if (!is_planar() || m_n_channels == 1)
+                return view().write_pnm(filename);
+
+        Image interleaved(m_width, m_height, m_n_channels);
+        convert_layout(*this, &interleaved);
+        return interleaved.view().write_pnm(filename);
+}
+
+bool ImageView::write_pnm(const std::string& filename) const
+{
+        TRACE_SCOPE("write_pnm");
+        string magic_head;
+        string extended_name;
+        if (m_n_channels == 1) {
+                magic_head = "P5";
+                extended_name = filename + ".pgm";
+        } else if (m_n_channels == 3) {
+                magic_head = "P6";
+                extended_name = filename + ".ppm";
+        } else {
+                cerr << "[ERROR][CENG391::Image] Only grayscale and rgb images can be saved as PNM files!\n";
                 return false;
         }
 
-        const string magic_head = "P5";
-        ofstream fout;
-        string extended_name = filename + ".pgm";
-        fout.open(extended_name.c_str(), ios::out | ios::binary);
-        fout << magic_head << "\n";
-        fout << m_width << " " << m_height << " 255\n";
-        for (int y = 0; y < m_height; ++y) {
-                const uchar *row_data = data(y);
-                fout.write(reinterpret_cast<const char*>(row_data), m_width*sizeof(uchar));
+        int fd = open(extended_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+                cerr << "[ERROR][CENG391::Image] Could not open " << extended_name << " for writing!\n";
+                return false;
         }
-        fout.close();
 
-        return true;
+        char header[64];
+        int header_size = snprintf(header, sizeof(header), "%s\n%d %d 255\n",
+                                   magic_head.c_str(), m_width, m_height);
+
+        // rows are gathered into a single writev call per batch, or written
+        // in one piece together with the header when there is no padding
+        const size_t row_size = (size_t) m_width*m_n_channels;
+        const int max_iov = 256;
+        struct iovec iov[max_iov];
+        iov[0].iov_base = header;
+        iov[0].iov_len = header_size;
+        int n_iov = 1;
+        bool ok = true;
+        if ((size_t) m_step == row_size) {
+                iov[1].iov_base = const_cast<uchar*>(m_data);
+                iov[1].iov_len = row_size*m_height;
+                ok = writev_all(fd, iov, 2);
+        } else {
+                for (int y = 0; y < m_height && ok; ++y) {
+                        iov[n_iov].iov_base = const_cast<uchar*>(data(y));
+                        iov[n_iov].iov_len = row_size;
+                        if (++n_iov == max_iov || y == m_height - 1) {
+                                ok = writev_all(fd, iov, n_iov);
+                                n_iov = 0;
+                        }
+                }
+                if (ok && m_height == 0)
+                        ok = writev_all(fd, iov, n_iov);
+        }
+
+        if (close(fd) != 0)
+                ok = false;
+        if (!ok)
+                cerr << "[ERROR][CENG391::Image] Could not write " << extended_name << "!\n";
+
+        return ok;
 }
 
-Image* Image::read_pnm(const std::string& filename)
+static const uchar* skip_pnm_space(const uchar* p, const uchar* end)
 {
-        FILE *pnm = fopen(filename.c_str(), "rb");
-        if (!pnm) {
-                fprintf(stderr, "Could not open image file %s\n", filename.c_str());
-                exit(EXIT_FAILURE);
+        while (p < end) {
+                if (*p == '#') {
+                        while (p < end && *p != '\n')
+                                ++p;
+                } else if (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') {
+                        ++p;
+                } else {
+                        break;
+                }
         }
+        return p;
+}
 
-        char ch1, ch2;
-        if (fscanf(pnm, "%c%c", &ch1, &ch2) != 2) {
-                fprintf(stderr, "Could not read image header from %s\n", filename.c_str());
-                exit(EXIT_FAILURE);
+static const uchar* parse_pnm_int(const uchar* p, const uchar* end, int* value)
+{
+        p = skip_pnm_space(p, end);
+        if (p == end || *p < '0' || *p > '9')
+                return 0;
+
+        int v = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+                if (v > 100000000)
+                        return 0;
+                v = v*10 + (*p - '0');
+                ++p;
         }
+        *value = v;
+        return p;
+}
 
-        if(ch1 != 'P' || (ch2 != '5' && ch2 != '6')) {
-                fprintf(stderr, "Image %s is not a valid binary PGM or PPM file", filename.c_str());
+Image* Image::read_pnm(const std::string& filename)
+{
+        string error;
+        Image* img = load_pnm(filename, &error);
+        if (!img) {
+                fprintf(stderr, "%s\n", error.c_str());
                 exit(EXIT_FAILURE);
         }
+        return img;
+}
 
-        int n_ch = -1;
-        if(ch2 == '5') {
-                n_ch = 1;
-        } else if(ch2 == '6') {
-                n_ch = 3;
+Image* Image::load_pnm(const std::string& filename, std::string* error)
+{
+        TRACE_SCOPE("read_pnm");
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+                *error = "Could not open image file " + filename;
+                return 0;
         }
 
-        int c = fgetc(pnm);
-        while (c == ' ' || c == '\n' || c == '\t') {
-                c = fgetc(pnm);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < 2) {
+                close(fd);
+                *error = "Could not read image header from " + filename;
+                return 0;
         }
 
-        while (c == '#') {
-                while (c != '\n') {
-                        c = fgetc(pnm);
-                        if (c == EOF) {
-                                fprintf(stderr, "%s does not contain image data", filename.c_str());
-                                exit(EXIT_FAILURE);
-                        }
-                }
-                c = fgetc(pnm);
+        size_t file_size = st.st_size;
+        void* mapping = mmap(0, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+                *error = "Could not map image file " + filename;
+                return 0;
         }
-        ungetc(c, pnm);
 
+        const uchar* begin = static_cast<const uchar*>(mapping);
+        const uchar* end = begin + file_size;
+        int n_ch = -1;
         int pnm_width;
         int pnm_height;
         int pnm_levels;
-        if (fscanf(pnm, "%d %d %d", &pnm_width, &pnm_height, &pnm_levels) != 3) {
-                fprintf(stderr, "Could not read image attributes from %s", filename.c_str());
-                exit(EXIT_FAILURE);
-        }
-        c = fgetc(pnm);
-
-        Image* img = new Image(pnm_width, pnm_height, n_ch);
-        for (int y = 0; y < img->m_height; ++y) {
-                uchar* row = img->data(y);
-                if (fread((void*)row, sizeof(uchar), img->m_width*n_ch, pnm) != img->m_width*n_ch) {
-                        fprintf(stderr, "Could not read data line %d from %s", y, filename.c_str());
-                        exit(EXIT_FAILURE);
+        const uchar* p = begin + 2;
+        if(begin[0] != 'P' || (begin[1] != '5' && begin[1] != '6')) {
+                *error = "Image " + filename + " is not a valid binary PGM or PPM file";
+        } else if ((p = parse_pnm_int(p, end, &pnm_width)) == 0
+                   || (p = parse_pnm_int(p, end, &pnm_height)) == 0
+                   || (p = parse_pnm_int(p, end, &pnm_levels)) == 0
+                   || p == end) {
+                *error = "Could not read image attributes from " + filename;
+        } else if (pnm_levels < 1 || pnm_levels > 255) {
+                *error = "Image " + filename + " does not have 8 bit samples";
+        } else {
+                n_ch = begin[1] == '5' ? 1 : 3;
+                // a single whitespace character separates the header from
+                // the data
+                ++p;
+                size_t data_size = (size_t) pnm_width * pnm_height * n_ch;
+                if ((size_t) (end - p) < data_size) {
+                        *error = filename + " does not contain enough image data";
+                        n_ch = -1;
                 }
         }
-        fclose(pnm);
+        if (n_ch < 0) {
+                munmap(mapping, file_size);
+                return 0;
+        }
+
+        madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+        Image* img = new Image();
+        img->m_width = pnm_width;
+        img->m_height = pnm_height;
+        img->m_n_channels = n_ch;
+        img->m_step = pnm_width * n_ch;
+        img->m_border = 0;
+        img->m_buffer = static_cast<uchar*>(mapping);
+        img->m_data = img->m_buffer + (p - begin);
+        img->m_mapped_size = file_size;
 
         return img;
 }
@@ -31,24 +31,100 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <cstddef>
 #include <string>
 
 #include "util.h"
 
 namespace ceng391 {
 
+struct Transform;
+
+// Non-owning reference to a rectangle of pixels with a row step, e.g. a
+// region of an Image. Views are cheap to copy and never free the pixels, the
+// image they point into must outlive them.
+//
+// The view of a planar image holds its n_planes() gray planes stacked on top
+// of each other, h() rows in total. Kernels that treat every sample the same
+// may use it as is, the geometric operations of Image interleave it first.
+class ImageView {
+public:
+        ImageView()
+                : m_data(0), m_width(0), m_height(0), m_n_channels(0), m_step(0),
+                  m_n_planes(1) {}
+        ImageView(uchar* data, int width, int height, int n_channels, int step,
+                  int n_planes = 1)
+                : m_data(data), m_width(width), m_height(height),
+                  m_n_channels(n_channels), m_step(step), m_n_planes(n_planes) {}
+
+        int w   () const { return m_width; }
+        int h   () const { return m_height; }
+        int n_ch() const { return m_n_channels; }
+        int step() const { return m_step; }
+        int n_planes() const { return m_n_planes; }
+
+        uchar* data() const { return m_data; }
+        uchar* data(int y) const { return m_data + (std::ptrdiff_t) y*m_step; }
+
+        // Region of this view, clipped to its bounds. Empty for stacked
+        // planes, a region of each plane is not one view.
+        ImageView sub(int x, int y, int width, int height) const;
+
+        void set_rect(int x, int y, int width, int height, uchar value) const;
+        void set(uchar value) const { set_rect(0, 0, m_width, m_height, value); }
+
+        bool write_pnm(const std::string& filename) const;
+private:
+        uchar* m_data;
+        int m_width;
+        int m_height;
+        int m_n_channels;
+        int m_step;
+        int m_n_planes;
+};
+
+// Interleaved images store the channels of a pixel next to each other,
+// planar images store each channel as a separate gray plane.
+enum Layout {
+        layout_interleaved,
+        layout_planar
+};
+
 class Image {
 public:
-        Image(int width, int height, int n_channels, int step = -1);
+        // Unless an explicit step is given, rows are padded to a multiple
+        // of row_align bytes and every row starts on a row_align boundary.
+        // A positive border adds that many zeroed guard pixels on each side
+        // so that kernels may read a few pixels past the edges.
+        Image(int width, int height, int n_channels, int step = -1, int border = 0);
         ~Image();
 
+        static const int row_align = 64;
+        static int aligned_step(int width, int n_channels);
+
         static Image* new_gray(int width, int height);
         static Image* new_rgb(int width, int height);
+        // Planes of n_channels aligned rows each, plane c follows plane
+        // c - 1 in memory.
+        static Image* new_planar(int width, int height, int n_channels);
 
         int w   () const { return m_width; }
         int h   () const { return m_height; }
         int n_ch() const { return m_n_channels; }
         int step() const { return m_step; }
+        int border() const { return m_border; }
+        Layout layout() const { return m_layout; }
+        bool is_planar() const { return m_layout == layout_planar; }
+
+        // The pixels of an interleaved image. For a planar image the planes
+        // stacked on top of each other, a gray view n_ch() times as high,
+        // which suits kernels that treat every sample the same.
+        ImageView view() const;
+        // Channel c of a planar image as a gray view, view() for an
+        // interleaved gray image and an empty view otherwise.
+        ImageView plane(int c) const;
+        // Region of view(), empty for planar images of several channels.
+        ImageView view(int x, int y, int width, int height) const { return view().sub(x, y, width, height); }
 
         uchar*       data()       { return m_data; }
         const uchar* data() const { return m_data; }
@@ -59,20 +135,72 @@ public:
         void set(uchar value) { set_rect(0, 0, m_width, m_height, value); }
         void set_zero() { set(0); }
 
+        // Converts the pixels to the given layout, nothing to do when the
+        // image already has it. Gray images have one plane and convert
+        // without copying. The geometric operations below work on
+        // interleaved pixels: the in place ones convert planar images to
+        // interleaved first and the static ones interleave the stacked
+        // planes of a planar view into a temporary copy.
+        void set_layout(Layout layout);
+
+        // Rotate this image in place and return its new pixels.
         uchar* rotate_bilinear(float angle);
         uchar* rotate_full_bilinear(float angle);
-        int interpolate_bilinear(float rotatedX, float rotatedY);
-        void rotate_cord(float angle, float *cord, int flag);
+        // Rotated copies of src, which may be a region of another image.
+        static Image* rotate_bilinear(const ImageView& src, float angle);
+        static Image* rotate_full_bilinear(const ImageView& src, float angle);
+        // Exact clockwise rotations by multiples of 90 degrees, transpose
+        // and mirror images. These permute the pixels without resampling,
+        // other angles are resampled onto the full canvas like
+        // rotate_full_bilinear().
+        uchar* rotate_right_angle(int angle);
+        uchar* transpose();
+        uchar* flip_horizontal();
+        uchar* flip_vertical();
+        static Image* rotate_right_angle(const ImageView& src, int angle);
+        static Image* transpose(const ImageView& src);
+        static Image* flip_horizontal(const ImageView& src);
+        static Image* flip_vertical(const ImageView& src);
+        // Warp by t onto the canvas that holds the whole mapped image.
+        uchar* warp(const Transform& t);
+        static Image* warp(const ImageView& src, const Transform& t);
+        int interpolate_bilinear(float rotatedX, float rotatedY, int channel = 0);
+        static int interpolate_bilinear(const ImageView& src, float rotatedX, float rotatedY,
+                                        int channel = 0);
+        static void rotate_cord(float angle, float *cord, int flag);
         void calculate_window_size(float angle, float** window);
+        static void calculate_window_size(int height, int width, float angle, float** window);
 
         bool write_pnm(const std::string& filename) const;
+        // Maps the file into memory and returns an image whose data()
+        // points into the mapping. The mapping is private so writing to
+        // the pixels copies the touched pages and never changes the file.
+        // Exits the program when the file cannot be read.
         static Image* read_pnm(const std::string& filename);
+        // Same as read_pnm(), but returns null and describes the problem
+        // in error instead of exiting.
+        static Image* load_pnm(const std::string& filename, std::string* error);
+
+        bool is_mapped() const { return m_mapped_size != 0; }
 private:
+        Image();
+
+        static uchar* allocate_pixels(std::size_t size);
+        static void free_pixels(uchar* pixels);
+
+        void release_data();
+        void take_data(Image* other);
+
         int m_width;
         int m_height;
         int m_n_channels;
         int m_step;
+        int m_border;
+        Layout m_layout;
         uchar* m_data;
+        // start of the allocation or mapping that m_data points into
+        uchar* m_buffer;
+        std::size_t m_mapped_size;
 };
 
 }
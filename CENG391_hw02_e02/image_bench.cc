@@ -0,0 +1,185 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bench.h"
+#include "image.h"
+#include "layout.h"
+
+using std::string;
+using std::vector;
+using ceng391::Bench;
+using ceng391::BenchOptions;
+using ceng391::Image;
+using ceng391::convert_layout;
+using ceng391::uchar;
+
+struct Input {
+        string name;
+        Image* img;
+};
+
+static Image* synthetic(int width, int height, int n_ch)
+{
+        Image* img = new Image(width, height, n_ch);
+        for (int y = 0; y < height; ++y) {
+                uchar* row = img->data(y);
+                for (int x = 0; x < width*n_ch; ++x)
+                        row[x] = (uchar) ((x*7) ^ (y*13));
+        }
+        return img;
+}
+
+// Path for a scratch file, write_pnm() appends the extension.
+static string temp_base()
+{
+        char name[] = "/tmp/image-bench-XXXXXX";
+        int fd = mkstemp(name);
+        if (fd >= 0) {
+                close(fd);
+                unlink(name);
+        }
+        return name;
+}
+
+static void bench_input(Bench& bench, const Input& in)
+{
+        Image* img = in.img;
+        const int w = img->w();
+        const int h = img->h();
+        const int n_ch = img->n_ch();
+        const double mb = w*(double) h*n_ch/1e6;
+        const double pixels = w*(double) h;
+
+        if (bench.enabled("set_rect", mb))
+                bench.run("set_rect", in.name, w, h, n_ch, pixels, [&]() {
+                        img->set_rect(0, 0, w, h, 17);
+                });
+
+        // rotations with a canvas of the same size or one that holds the
+        // whole image
+        if (bench.enabled("rotate_bilinear_30", 2*mb))
+                bench.run("rotate_bilinear_30", in.name, w, h, n_ch, pixels, [&]() {
+                        delete Image::rotate_bilinear(img->view(), 30);
+                });
+        if (bench.enabled("rotate_full_bilinear_30", 3*mb))
+                bench.run("rotate_full_bilinear_30", in.name, w, h, n_ch, pixels, [&]() {
+                        delete Image::rotate_full_bilinear(img->view(), 30);
+                });
+        if (bench.enabled("rotate_full_bilinear_90", 2*mb))
+                bench.run("rotate_full_bilinear_90", in.name, w, h, n_ch, pixels, [&]() {
+                        delete Image::rotate_full_bilinear(img->view(), 90);
+                });
+        if (bench.enabled("flip_horizontal", 2*mb))
+                bench.run("flip_horizontal", in.name, w, h, n_ch, pixels, [&]() {
+                        delete Image::flip_horizontal(img->view());
+                });
+
+        // layout conversions both ways, the planes are kept for the second
+        if (n_ch > 1 && (bench.enabled("to_planar", 2*mb) || bench.enabled("to_interleaved", 2*mb))) {
+                Image* planar = Image::new_planar(w, h, n_ch);
+                if (bench.enabled("to_planar", 2*mb))
+                        bench.run("to_planar", in.name, w, h, n_ch, pixels, [&]() {
+                                convert_layout(*img, planar);
+                        });
+                else
+                        convert_layout(*img, planar);
+                Image interleaved(w, h, n_ch);
+                if (bench.enabled("to_interleaved", 2*mb))
+                        bench.run("to_interleaved", in.name, w, h, n_ch, pixels, [&]() {
+                                convert_layout(*planar, &interleaved);
+                        });
+                delete planar;
+        }
+
+        const string base = temp_base();
+        const string file = base + (n_ch == 1 ? ".pgm" : ".ppm");
+        if (bench.enabled("write_pnm", mb) || bench.enabled("read_pnm", mb)) {
+                if (bench.enabled("write_pnm", mb))
+                        bench.run("write_pnm", in.name, w, h, n_ch, pixels, [&]() {
+                                img->write_pnm(base);
+                        });
+                else
+                        img->write_pnm(base);
+        }
+        // read_pnm() maps the file, touch every row so the pixels are loaded
+        if (bench.enabled("read_pnm", mb))
+                bench.run("read_pnm", in.name, w, h, n_ch, pixels, [&]() {
+                        Image* read = Image::read_pnm(file);
+                        volatile uchar sum = 0;
+                        for (int y = 0; read && y < read->h(); ++y)
+                                for (int x = 0; x < read->w()*read->n_ch(); x += 64)
+                                        sum += read->data(y)[x];
+                        delete read;
+                });
+        unlink(file.c_str());
+}
+
+// Times the operations of this homework on Images/house.pgm and house.ppm and
+// on synthetic gray and rgb images of the requested sizes.
+int main(int argc, char** argv)
+{
+        BenchOptions options;
+        if (!options.parse(argc, argv))
+                return EXIT_FAILURE;
+        Bench bench(options);
+
+        const char* houses[] = { "house.pgm", "house.ppm" };
+        for (int i = 0; i < 2; ++i) {
+                string error;
+                Input in = { houses[i], Image::load_pnm(options.images + "/" + houses[i], &error) };
+                if (!in.img) {
+                        std::fprintf(stderr, "[WARNING][CENG391::Bench] Skipping %s: %s\n",
+                                     houses[i], error.c_str());
+                        continue;
+                }
+                bench_input(bench, in);
+                delete in.img;
+        }
+
+        for (size_t i = 0; i < options.sizes.size(); ++i) {
+                const int side = options.sizes[i];
+                for (int n_ch = 1; n_ch <= 3; n_ch += 2) {
+                        if (side*(double) side*n_ch/1e6 > options.max_mb)
+                                continue;
+                        Input in = { n_ch == 1 ? "gray" : "rgb", synthetic(side, side, n_ch) };
+                        bench_input(bench, in);
+                        delete in.img;
+                }
+        }
+
+        return EXIT_SUCCESS;
+}
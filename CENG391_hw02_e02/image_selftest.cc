@@ -0,0 +1,220 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include "async_writer.h"
+#include "image.h"
+
+using std::cerr;
+using std::string;
+using ceng391::Image;
+using ceng391::uchar;
+
+static int n_failed = 0;
+
+static void check(bool ok, const char* what)
+{
+        if (!ok) {
+                cerr << "[FAIL] " << what << "\n";
+                ++n_failed;
+        }
+}
+
+static bool same_pixels(const Image& a, const Image& b)
+{
+        if (a.w() != b.w() || a.h() != b.h() || a.n_ch() != b.n_ch()
+            || a.layout() != b.layout())
+                return false;
+        for (int y = 0; y < a.h(); ++y)
+                if (memcmp(a.data(y), b.data(y), (size_t) a.w()*a.n_ch()) != 0)
+                        return false;
+        return true;
+}
+
+static Image* pattern_rgb(int width, int height)
+{
+        Image* img = Image::new_rgb(width, height);
+        for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width*3; ++x)
+                        img->data(y)[x] = (uchar) (x*7 + y*13);
+        return img;
+}
+
+// The in place geometric operations must give the same pixels for planar
+// and interleaved copies of an image.
+static void test_planar_rotation()
+{
+        const float angles[] = { 30.0f, 90.0f, 180.0f };
+        for (int i = 0; i < 3; ++i) {
+                Image* interleaved = pattern_rgb(20, 10);
+                Image* planar = pattern_rgb(20, 10);
+                planar->set_layout(ceng391::layout_planar);
+
+                interleaved->rotate_full_bilinear(angles[i]);
+                planar->rotate_full_bilinear(angles[i]);
+                check(same_pixels(*interleaved, *planar), "planar rotate_full_bilinear");
+
+                interleaved->rotate_bilinear(angles[i]);
+                planar->set_layout(ceng391::layout_planar);
+                planar->rotate_bilinear(angles[i]);
+                check(same_pixels(*interleaved, *planar), "planar rotate_bilinear");
+
+                delete interleaved;
+                delete planar;
+        }
+
+        Image* interleaved = pattern_rgb(20, 10);
+        Image* planar = pattern_rgb(20, 10);
+        planar->set_layout(ceng391::layout_planar);
+        check(planar->interpolate_bilinear(3.5f, 2.25f, 1)
+              == interleaved->interpolate_bilinear(3.5f, 2.25f, 1),
+              "planar interpolate_bilinear");
+        interleaved->transpose();
+        planar->transpose();
+        check(same_pixels(*interleaved, *planar), "planar transpose");
+        delete interleaved;
+        delete planar;
+}
+
+// The static geometric operations interleave the view of a planar image
+// instead of moving its planes into each other, and planar images cannot be
+// cropped to a single view.
+static void test_planar_view()
+{
+        Image* interleaved = pattern_rgb(20, 10);
+        Image* planar = pattern_rgb(20, 10);
+        planar->set_layout(ceng391::layout_planar);
+
+        Image* a = Image::rotate_full_bilinear(interleaved->view(), 30.0f);
+        Image* b = Image::rotate_full_bilinear(planar->view(), 30.0f);
+        check(same_pixels(*a, *b), "rotate_full_bilinear of a planar view");
+        delete a;
+        delete b;
+
+        a = Image::flip_vertical(interleaved->view());
+        b = Image::flip_vertical(planar->view());
+        check(same_pixels(*a, *b), "flip_vertical of a planar view");
+        delete a;
+        delete b;
+
+        check(Image::interpolate_bilinear(planar->view(), 3.5f, 2.25f, 2)
+              == interleaved->interpolate_bilinear(3.5f, 2.25f, 2),
+              "interpolate_bilinear of a planar view");
+
+        ceng391::ImageView crop = planar->view(0, 0, 20, 10);
+        check(crop.w() == 0 && crop.h() == 0, "crop of a planar image");
+
+        delete interleaved;
+        delete planar;
+}
+
+// Right angle rotations only permute pixels, other angles resample like
+// rotate_full_bilinear() instead of being truncated.
+static void test_right_angle()
+{
+        Image* img = pattern_rgb(40, 30);
+        Image* r90 = Image::rotate_right_angle(img->view(), 90);
+        check(r90->w() == 30 && r90->h() == 40
+              && r90->data(0)[0] == img->data(29)[0], "rotate_right_angle 90");
+        Image* r45 = Image::rotate_right_angle(img->view(), 45);
+        Image* full = Image::rotate_full_bilinear(img->view(), 45.0f);
+        check(same_pixels(*r45, *full), "rotate_right_angle 45");
+        Image* big = Image::rotate_full_bilinear(img->view(), std::ldexp(90.0f, 40));
+        check(big->w() == 40 && big->h() == 30, "rotate_full_bilinear of a huge right angle");
+        delete img;
+        delete r90;
+        delete r45;
+        delete full;
+        delete big;
+}
+
+// Images written by AsyncPnmWriter read back unchanged, and failed writes
+// are reported.
+static void test_async_writer()
+{
+        char dir[] = "/tmp/image-selftest-XXXXXX";
+        if (!mkdtemp(dir)) {
+                check(false, "temporary directory");
+                return;
+        }
+
+        const int n_images = 6;
+        Image* expected[n_images];
+        int n_ok = 0;
+        {
+                ceng391::AsyncPnmWriter writer(2);
+                for (int i = 0; i < n_images; ++i) {
+                        Image* img = pattern_rgb(17 + i, 9 + 2*i);
+                        if (i % 2 == 0)
+                                img->set_layout(ceng391::layout_planar);
+                        expected[i] = pattern_rgb(17 + i, 9 + 2*i);
+                        writer.submit(img, string(dir) + "/" + std::to_string(i),
+                                      [&](bool ok) { n_ok += ok; });
+                }
+                check(writer.flush(), "async writes succeed");
+
+                writer.submit(pattern_rgb(4, 4), string(dir) + "/missing/image");
+                check(!writer.flush(), "async write failure is reported");
+        }
+        check(n_ok == n_images, "async write callbacks");
+
+        for (int i = 0; i < n_images; ++i) {
+                const string file = string(dir) + "/" + std::to_string(i) + ".ppm";
+                string error;
+                Image* read = Image::load_pnm(file, &error);
+                check(read && same_pixels(*read, *expected[i]), "async write round trip");
+                delete read;
+                delete expected[i];
+                unlink(file.c_str());
+        }
+        rmdir(dir);
+}
+
+// Checks that do not need any input files, run by ctest.
+int main()
+{
+        test_planar_rotation();
+        test_planar_view();
+        test_right_angle();
+        test_async_writer();
+
+        if (n_failed != 0) {
+                cerr << n_failed << " checks failed\n";
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,259 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "layout.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+using std::memcpy;
+using std::vector;
+
+namespace ceng391 {
+
+static void deinterleave_scalar(const uchar* src, uchar* const* planes, int first, int width, int n_ch)
+{
+        for (int c = 0; c < n_ch; ++c) {
+                const uchar* s = src + c;
+                uchar* d = planes[c];
+                for (int i = first; i < width; ++i)
+                        d[i] = s[i*n_ch];
+        }
+}
+
+static void interleave_scalar(const uchar* const* planes, uchar* dst, int first, int width, int n_ch)
+{
+        for (int c = 0; c < n_ch; ++c) {
+                const uchar* s = planes[c];
+                uchar* d = dst + c;
+                for (int i = first; i < width; ++i)
+                        d[i*n_ch] = s[i];
+        }
+}
+
+#if defined(__SSE2__)
+
+// Sixteen pixels per step. Four channels are a 16x4 byte transpose: four
+// rounds of pairing the bytes of vectors i and i + 2 leave channel c in
+// vector c. Three channels need byte shuffles, each output vector gathers
+// its bytes from the three input vectors.
+
+static int deinterleave4_sse2(const uchar* src, uchar* const* planes, int width)
+{
+        int i = 0;
+        for (; i + 16 <= width; i += 16) {
+                __m128i x[4];
+                for (int k = 0; k < 4; ++k)
+                        x[k] = _mm_loadu_si128((const __m128i*) (src + 4*i + 16*k));
+                for (int round = 0; round < 4; ++round) {
+                        __m128i y0 = _mm_unpacklo_epi8(x[0], x[2]);
+                        __m128i y1 = _mm_unpackhi_epi8(x[0], x[2]);
+                        __m128i y2 = _mm_unpacklo_epi8(x[1], x[3]);
+                        __m128i y3 = _mm_unpackhi_epi8(x[1], x[3]);
+                        x[0] = y0;
+                        x[1] = y1;
+                        x[2] = y2;
+                        x[3] = y3;
+                }
+                for (int c = 0; c < 4; ++c)
+                        _mm_storeu_si128((__m128i*) (planes[c] + i), x[c]);
+        }
+        return i;
+}
+
+static int interleave4_sse2(const uchar* const* planes, uchar* dst, int width)
+{
+        int i = 0;
+        for (; i + 16 <= width; i += 16) {
+                __m128i r = _mm_loadu_si128((const __m128i*) (planes[0] + i));
+                __m128i g = _mm_loadu_si128((const __m128i*) (planes[1] + i));
+                __m128i b = _mm_loadu_si128((const __m128i*) (planes[2] + i));
+                __m128i a = _mm_loadu_si128((const __m128i*) (planes[3] + i));
+                __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+                __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+                __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+                __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+                _mm_storeu_si128((__m128i*) (dst + 4*i), _mm_unpacklo_epi16(rg_lo, ba_lo));
+                _mm_storeu_si128((__m128i*) (dst + 4*i + 16), _mm_unpackhi_epi16(rg_lo, ba_lo));
+                _mm_storeu_si128((__m128i*) (dst + 4*i + 32), _mm_unpacklo_epi16(rg_hi, ba_hi));
+                _mm_storeu_si128((__m128i*) (dst + 4*i + 48), _mm_unpackhi_epi16(rg_hi, ba_hi));
+        }
+        return i;
+}
+
+// bytes[v][k] picks the bytes of output vector v that come from input
+// vector k, the others are cleared by -1. Deinterleaving reads the pixel
+// block and writes planes, interleaving the other way around.
+struct ShuffleMasks {
+        explicit ShuffleMasks(bool interleave)
+        {
+                for (int v = 0; v < 3; ++v) {
+                        for (int j = 0; j < 16; ++j) {
+                                // input vector and byte of output byte j
+                                int from, byte;
+                                if (interleave) {
+                                        from = (16*v + j) % 3;
+                                        byte = (16*v + j) / 3;
+                                } else {
+                                        from = (3*j + v) / 16;
+                                        byte = (3*j + v) % 16;
+                                }
+                                for (int k = 0; k < 3; ++k)
+                                        bytes[v][k][j] = k == from ? (char) byte : (char) -1;
+                        }
+                }
+        }
+
+        char bytes[3][3][16];
+};
+
+static const ShuffleMasks deinterleave_masks(false);
+static const ShuffleMasks interleave_masks(true);
+
+__attribute__((target("ssse3")))
+static inline void shuffle3_ssse3(const __m128i* x, __m128i* y, const ShuffleMasks& m)
+{
+        for (int v = 0; v < 3; ++v) {
+                __m128i acc = _mm_shuffle_epi8(x[0], _mm_loadu_si128((const __m128i*) m.bytes[v][0]));
+                acc = _mm_or_si128(acc, _mm_shuffle_epi8(x[1], _mm_loadu_si128((const __m128i*) m.bytes[v][1])));
+                acc = _mm_or_si128(acc, _mm_shuffle_epi8(x[2], _mm_loadu_si128((const __m128i*) m.bytes[v][2])));
+                y[v] = acc;
+        }
+}
+
+__attribute__((target("ssse3")))
+static int deinterleave3_ssse3(const uchar* src, uchar* const* planes, int width)
+{
+        int i = 0;
+        for (; i + 16 <= width; i += 16) {
+                __m128i x[3], y[3];
+                for (int k = 0; k < 3; ++k)
+                        x[k] = _mm_loadu_si128((const __m128i*) (src + 3*i + 16*k));
+                shuffle3_ssse3(x, y, deinterleave_masks);
+                for (int c = 0; c < 3; ++c)
+                        _mm_storeu_si128((__m128i*) (planes[c] + i), y[c]);
+        }
+        return i;
+}
+
+__attribute__((target("ssse3")))
+static int interleave3_ssse3(const uchar* const* planes, uchar* dst, int width)
+{
+        int i = 0;
+        for (; i + 16 <= width; i += 16) {
+                __m128i x[3], y[3];
+                for (int c = 0; c < 3; ++c)
+                        x[c] = _mm_loadu_si128((const __m128i*) (planes[c] + i));
+                shuffle3_ssse3(x, y, interleave_masks);
+                for (int k = 0; k < 3; ++k)
+                        _mm_storeu_si128((__m128i*) (dst + 3*i + 16*k), y[k]);
+        }
+        return i;
+}
+
+static bool has_ssse3()
+{
+        static const bool ssse3 = __builtin_cpu_supports("ssse3");
+        return ssse3;
+}
+
+#endif
+
+void deinterleave_row(const uchar* src, uchar* const* planes, int width, int n_ch)
+{
+        int i = 0;
+        if (n_ch == 1) {
+                memcpy(planes[0], src, width);
+                return;
+        }
+#if defined(__SSE2__)
+        if (n_ch == 4)
+                i = deinterleave4_sse2(src, planes, width);
+        else if (n_ch == 3 && has_ssse3())
+                i = deinterleave3_ssse3(src, planes, width);
+#endif
+        deinterleave_scalar(src, planes, i, width, n_ch);
+}
+
+void interleave_row(const uchar* const* planes, uchar* dst, int width, int n_ch)
+{
+        int i = 0;
+        if (n_ch == 1) {
+                memcpy(dst, planes[0], width);
+                return;
+        }
+#if defined(__SSE2__)
+        if (n_ch == 4)
+                i = interleave4_sse2(planes, dst, width);
+        else if (n_ch == 3 && has_ssse3())
+                i = interleave3_ssse3(planes, dst, width);
+#endif
+        interleave_scalar(planes, dst, i, width, n_ch);
+}
+
+void convert_layout(const Image& src, Image* dst)
+{
+        TRACE_SCOPE("convert_layout");
+        const int n_ch = src.n_ch();
+        if (src.layout() == dst->layout() || n_ch == 1) {
+                const int n_planes = src.is_planar() ? n_ch : 1;
+                for (int c = 0; c < n_planes; ++c) {
+                        const ImageView s = src.is_planar() ? src.plane(c) : src.view();
+                        const ImageView d = src.is_planar() ? dst->plane(c) : dst->view();
+                        for (int y = 0; y < s.h(); ++y)
+                                memcpy(d.data(y), s.data(y), (size_t) s.w()*s.n_ch());
+                }
+                return;
+        }
+
+        const bool split = !src.is_planar();
+        const Image& planar = split ? *dst : src;
+        const ImageView pixels = split ? src.view() : dst->view();
+        parallel_for_rows(src.h(), [&](int y0, int y1) {
+                vector<uchar*> planes(n_ch);
+                for (int y = y0; y < y1; ++y) {
+                        for (int c = 0; c < n_ch; ++c)
+                                planes[c] = planar.plane(c).data(y);
+                        if (split)
+                                deinterleave_row(pixels.data(y), planes.data(), src.w(), n_ch);
+                        else
+                                interleave_row(planes.data(), pixels.data(y), src.w(), n_ch);
+                }
+        });
+}
+
+}
@@ -0,0 +1,303 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "orient.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::memcpy;
+
+namespace ceng391 {
+
+Orientation right_angle_orientation(int angle)
+{
+        switch (((angle / 90) % 4 + 4) % 4) {
+        case 1: return orientation_rotate_90;
+        case 2: return orientation_rotate_180;
+        case 3: return orientation_rotate_270;
+        default: return orientation_normal;
+        }
+}
+
+// The transposing orientations write dst(i, j) = src(r(j), c(i)) where r
+// reverses the rows and c the columns when asked to.
+struct Transposition {
+        Transposition(const ImageView& src, const ImageView& dst, Orientation o)
+                : src(src), dst(dst),
+                  reverse_rows(o == orientation_rotate_90 || o == orientation_transverse),
+                  reverse_cols(o == orientation_rotate_270 || o == orientation_transverse) {}
+
+        const uchar* source(int i, int j) const
+        {
+                int r = reverse_rows ? src.h() - 1 - j : j;
+                int c = reverse_cols ? src.w() - 1 - i : i;
+                return src.data(r) + c*src.n_ch();
+        }
+
+        // Pixel by pixel, for the partial blocks along the edges.
+        void copy(int i0, int i1, int j0, int j1) const
+        {
+                const int n = src.n_ch();
+                for (int i = i0; i < i1; ++i) {
+                        uchar* d = dst.data(i) + j0*n;
+                        for (int j = j0; j < j1; ++j, d += n)
+                                memcpy(d, source(i, j), n);
+                }
+        }
+
+        ImageView src;
+        ImageView dst;
+        bool reverse_rows;
+        bool reverse_cols;
+};
+
+// Transposes a size x size block of N byte pixels, d[k][l] = s[l][k].
+template <int N>
+struct Block {
+        static const int size = 8;
+
+        static void transpose(const uchar* const* s, uchar* const* d)
+        {
+                for (int k = 0; k < size; ++k)
+                        for (int l = 0; l < size; ++l)
+                                memcpy(d[k] + l*N, s[l] + k*N, N);
+        }
+};
+
+#if defined(__SSE2__)
+template <>
+struct Block<1> {
+        static const int size = 16;
+
+        // Four rounds of interleaving row i with row i + 8 leave the
+        // transpose in the registers.
+        static void transpose(const uchar* const* s, uchar* const* d)
+        {
+                __m128i x[16];
+                __m128i t[16];
+                for (int l = 0; l < 16; ++l)
+                        x[l] = _mm_loadu_si128((const __m128i*) s[l]);
+
+                for (int round = 0; round < 4; ++round) {
+                        for (int i = 0; i < 8; ++i) {
+                                t[2*i] = _mm_unpacklo_epi8(x[i], x[i + 8]);
+                                t[2*i + 1] = _mm_unpackhi_epi8(x[i], x[i + 8]);
+                        }
+                        for (int i = 0; i < 16; ++i)
+                                x[i] = t[i];
+                }
+
+                for (int k = 0; k < 16; ++k)
+                        _mm_storeu_si128((__m128i*) d[k], x[k]);
+        }
+};
+
+template <>
+struct Block<4> {
+        static const int size = 8;
+
+        static void transpose(const uchar* const* s, uchar* const* d)
+        {
+                // four 4x4 transposes of 32-bit pixels
+                for (int kb = 0; kb < 8; kb += 4) {
+                        for (int lb = 0; lb < 8; lb += 4) {
+                                __m128i a = _mm_loadu_si128((const __m128i*) (s[lb] + 4*kb));
+                                __m128i b = _mm_loadu_si128((const __m128i*) (s[lb + 1] + 4*kb));
+                                __m128i c = _mm_loadu_si128((const __m128i*) (s[lb + 2] + 4*kb));
+                                __m128i e = _mm_loadu_si128((const __m128i*) (s[lb + 3] + 4*kb));
+                                __m128i t0 = _mm_unpacklo_epi32(a, b);
+                                __m128i t1 = _mm_unpacklo_epi32(c, e);
+                                __m128i t2 = _mm_unpackhi_epi32(a, b);
+                                __m128i t3 = _mm_unpackhi_epi32(c, e);
+                                _mm_storeu_si128((__m128i*) (d[kb] + 4*lb), _mm_unpacklo_epi64(t0, t1));
+                                _mm_storeu_si128((__m128i*) (d[kb + 1] + 4*lb), _mm_unpackhi_epi64(t0, t1));
+                                _mm_storeu_si128((__m128i*) (d[kb + 2] + 4*lb), _mm_unpacklo_epi64(t2, t3));
+                                _mm_storeu_si128((__m128i*) (d[kb + 3] + 4*lb), _mm_unpackhi_epi64(t2, t3));
+                        }
+                }
+        }
+};
+#endif
+
+static const int tile_size = 64;
+
+// Transposes the destination rows [i0, i1) and columns [j0, j1) in square
+// blocks. Within a block the source rows come from r and the destination
+// rows from c, so the reversals only reorder pointers. N = 0 stands for any
+// other number of channels and copies pixel by pixel.
+template <int N>
+static void transpose_tile(const Transposition& t, int i0, int i1, int j0, int j1)
+{
+        if (N == 0) {
+                t.copy(i0, i1, j0, j1);
+                return;
+        }
+
+        const int B = Block<N>::size;
+        const int src_h = t.src.h();
+        const int src_w = t.src.w();
+        const uchar* s[B];
+        uchar* d[B];
+
+        int i = i0;
+        for (; i + B <= i1; i += B) {
+                const int c0 = t.reverse_cols ? src_w - B - i : i;
+                int j = j0;
+                for (; j + B <= j1; j += B) {
+                        for (int l = 0; l < B; ++l) {
+                                int r = t.reverse_rows ? src_h - 1 - j - l : j + l;
+                                s[l] = t.src.data(r) + c0*N;
+                        }
+                        for (int k = 0; k < B; ++k) {
+                                int row = t.reverse_cols ? i + B - 1 - k : i + k;
+                                d[k] = t.dst.data(row) + j*N;
+                        }
+                        Block<N>::transpose(s, d);
+                }
+                t.copy(i, i + B, j, j1);
+        }
+        t.copy(i, i1, j0, j1);
+}
+
+template <int N>
+static void transpose_bands(const Transposition& t)
+{
+        const int n_bands = (t.dst.h() + tile_size - 1) / tile_size;
+        parallel_for_rows(n_bands, [&](int b0, int b1) {
+                for (int b = b0; b < b1; ++b) {
+                        int i0 = b*tile_size;
+                        int i1 = i0 + tile_size < t.dst.h() ? i0 + tile_size : t.dst.h();
+                        for (int j0 = 0; j0 < t.dst.w(); j0 += tile_size) {
+                                int j1 = j0 + tile_size < t.dst.w() ? j0 + tile_size : t.dst.w();
+                                transpose_tile<N>(t, i0, i1, j0, j1);
+                        }
+                }
+        }, 1);
+}
+
+// Reverses the order of the width pixels of N bytes in a row, N = 0 uses
+// the run time pixel size n.
+template <int N>
+static void reverse_row(const uchar* src, uchar* dst, int width, int n)
+{
+        const uchar* s = src + (width - 1)*n;
+        for (int x = 0; x < width; ++x, s -= n, dst += n)
+                memcpy(dst, s, N ? N : n);
+}
+
+#if defined(__SSE2__)
+template <>
+void reverse_row<1>(const uchar* src, uchar* dst, int width, int)
+{
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*) (src + width - 16 - x));
+                v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+                v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+                v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                _mm_storeu_si128((__m128i*) (dst + x), v);
+        }
+        for (; x < width; ++x)
+                dst[x] = src[width - 1 - x];
+}
+
+template <>
+void reverse_row<4>(const uchar* src, uchar* dst, int width, int)
+{
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i*) (src + 4*(width - 4 - x)));
+                v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+                _mm_storeu_si128((__m128i*) (dst + 4*x), v);
+        }
+        for (; x < width; ++x)
+                memcpy(dst + 4*x, src + 4*(width - 1 - x), 4);
+}
+#endif
+
+template <int N>
+static void reverse_rows(const ImageView& src, const ImageView& dst, bool flip_rows)
+{
+        parallel_for_rows(dst.h(), [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y) {
+                        const uchar* s = src.data(flip_rows ? src.h() - 1 - y : y);
+                        reverse_row<N>(s, dst.data(y), src.w(), src.n_ch());
+                }
+        });
+}
+
+static void copy_rows(const ImageView& src, const ImageView& dst, bool flip_rows)
+{
+        const size_t row_size = (size_t) src.w()*src.n_ch();
+        parallel_for_rows(dst.h(), [&](int y0, int y1) {
+                for (int y = y0; y < y1; ++y)
+                        memcpy(dst.data(y), src.data(flip_rows ? src.h() - 1 - y : y), row_size);
+        });
+}
+
+void reorient(const ImageView& src, const ImageView& dst, Orientation o)
+{
+        TRACE_SCOPE("reorient");
+        if (src.w() <= 0 || src.h() <= 0)
+                return;
+
+        if (swaps_axes(o)) {
+                Transposition t(src, dst, o);
+                switch (src.n_ch()) {
+                case 1: transpose_bands<1>(t); break;
+                case 3: transpose_bands<3>(t); break;
+                case 4: transpose_bands<4>(t); break;
+                default: transpose_bands<0>(t); break;
+                }
+                return;
+        }
+
+        if (o == orientation_normal || o == orientation_flip_vertical) {
+                copy_rows(src, dst, o == orientation_flip_vertical);
+                return;
+        }
+
+        const bool flip_rows = o == orientation_rotate_180;
+        switch (src.n_ch()) {
+        case 1: reverse_rows<1>(src, dst, flip_rows); break;
+        case 3: reverse_rows<3>(src, dst, flip_rows); break;
+        case 4: reverse_rows<4>(src, dst, flip_rows); break;
+        default: reverse_rows<0>(src, dst, flip_rows); break;
+        }
+}
+
+}
@@ -0,0 +1,68 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef ORIENT_H
+#define ORIENT_H
+
+#include "image.h"
+
+namespace ceng391 {
+
+// The eight exact orientations, numbered as in the EXIF orientation tag.
+// Each names the operation that brings a frame with that tag upright, so
+// orientation_rotate_90 turns the image 90 degrees clockwise.
+enum Orientation {
+        orientation_normal = 1,
+        orientation_flip_horizontal = 2,
+        orientation_rotate_180 = 3,
+        orientation_flip_vertical = 4,
+        orientation_transpose = 5,
+        orientation_rotate_90 = 6,
+        orientation_transverse = 7,
+        orientation_rotate_270 = 8
+};
+
+// Orientation of a clockwise rotation by a multiple of 90 degrees, other
+// angles are rounded towards zero to one.
+Orientation right_angle_orientation(int angle);
+
+// True when o exchanges the width and the height.
+inline bool swaps_axes(Orientation o) { return o >= orientation_transpose; }
+
+// Writes src in orientation o to dst, which has the swapped size when
+// swaps_axes(o) and must not overlap src. This is an exact permutation of
+// the pixels. The transposing orientations work on 64x64 tiles made of
+// blocks that are transposed in SSE2 registers, 16x16 for gray and 8x8 for
+// four channels. The others copy rows or reverse them.
+void reorient(const ImageView& src, const ImageView& dst, Orientation o);
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "image.h"
+#include "rotate.h"
+
+using std::cerr;
+using std::endl;
+using ceng391::Image;
+using ceng391::uchar;
+
+// Seconds per call of rotate() at the given angle, best of n_runs.
+static double time_rotate(const Image* src, Image* dst, float angle, int n_runs)
+{
+        double best = 1e30;
+        for (int r = 0; r < n_runs; ++r) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                ceng391::rotate(src->view(), dst->view(), angle);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                if (elapsed.count() < best)
+                        best = elapsed.count();
+        }
+        return best;
+}
+
+// Rotates a gray image at angles from 0 to 180 degrees with whole-row and
+// tiled traversal and prints the throughput in output megapixels per
+// second. Without an argument a 4096x3072 test pattern is used, large
+// enough that the source does not fit in L2.
+int main(int argc, char** argv)
+{
+        Image* src;
+        if (argc > 1) {
+                src = Image::read_pnm(argv[1]);
+                if (!src) {
+                        cerr << "Could not read " << argv[1] << endl;
+                        return EXIT_FAILURE;
+                }
+        } else {
+                src = Image::new_gray(4096, 3072);
+                for (int y = 0; y < src->h(); ++y)
+                        for (int x = 0; x < src->w(); ++x)
+                                src->data(y)[x] = (uchar) (x ^ y);
+        }
+
+        Image* dst = Image::new_gray(src->w(), src->h());
+        const double mpix = src->w()*(double) src->h()/1e6;
+        const int tile = ceng391::warp_tile_size();
+
+        std::printf("angle  rows_mpix_s  tiled_mpix_s\n");
+        for (int angle = 0; angle <= 180; angle += 10) {
+                ceng391::set_warp_tile_size(0);
+                double rows = time_rotate(src, dst, (float) angle, 5);
+                ceng391::set_warp_tile_size(tile);
+                double tiled = time_rotate(src, dst, (float) angle, 5);
+                std::printf("%5d  %11.1f  %12.1f\n", angle, mpix/rows, mpix/tiled);
+        }
+
+        delete dst;
+        delete src;
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using std::cerr;
+using std::string;
+using std::vector;
+
+namespace ceng391 {
+
+std::atomic<bool> trace_on(false);
+
+namespace {
+
+struct Event {
+        const char* name;
+        long long start;
+        long long end;
+};
+
+// Events of one thread, the oldest ones are overwritten once it is full.
+// Only the owning thread writes, n_written is published for the reader.
+struct ThreadTrace {
+        static const size_t capacity = 1 << 16;
+
+        explicit ThreadTrace(int tid) : events(capacity), n_written(0), tid(tid) {}
+
+        vector<Event> events;
+        std::atomic<size_t> n_written;
+        int tid;
+};
+
+std::mutex registry_mutex;
+// never freed, events of finished threads can still be written out
+vector<ThreadTrace*>* registry = 0;
+
+ThreadTrace* thread_trace()
+{
+        static thread_local ThreadTrace* trace = 0;
+        if (!trace) {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                if (!registry)
+                        registry = new vector<ThreadTrace*>;
+                trace = new ThreadTrace((int) registry->size() + 1);
+                registry->push_back(trace);
+        }
+        return trace;
+}
+
+const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+string trace_file;
+
+void write_trace_at_exit()
+{
+        if (!write_trace_json(trace_file))
+                cerr << "[ERROR][CENG391::trace] Could not write " << trace_file << "!\n";
+}
+
+// CENG391_TRACE=file.json turns tracing on before main()
+struct TraceFromEnvironment {
+        TraceFromEnvironment()
+        {
+                const char* file = std::getenv("CENG391_TRACE");
+                if (!file || !*file)
+                        return;
+                trace_file = file;
+                set_trace_enabled(true);
+                std::atexit(write_trace_at_exit);
+        }
+} trace_from_environment;
+
+}
+
+void set_trace_enabled(bool enabled)
+{
+        trace_on.store(enabled, std::memory_order_relaxed);
+}
+
+long long trace_now()
+{
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+void trace_event(const char* name, long long start, long long end)
+{
+        ThreadTrace* t = thread_trace();
+        size_t n = t->n_written.load(std::memory_order_relaxed);
+        Event& e = t->events[n % ThreadTrace::capacity];
+        e.name = name;
+        e.start = start;
+        e.end = end;
+        t->n_written.store(n + 1, std::memory_order_release);
+}
+
+// Names are string literals of this code base, only quotes and backslashes
+// need escaping.
+static void write_json_string(FILE* f, const char* s)
+{
+        std::fputc('"', f);
+        for (; *s; ++s) {
+                if (*s == '"' || *s == '\\')
+                        std::fputc('\\', f);
+                std::fputc(*s, f);
+        }
+        std::fputc('"', f);
+}
+
+bool write_trace_json(const string& filename)
+{
+        FILE* f = std::fopen(filename.c_str(), "w");
+        if (!f)
+                return false;
+
+        std::fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        bool first = true;
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (size_t i = 0; registry && i < registry->size(); ++i) {
+                const ThreadTrace* t = (*registry)[i];
+                size_t n = t->n_written.load(std::memory_order_acquire);
+                size_t begin = n > ThreadTrace::capacity ? n - ThreadTrace::capacity : 0;
+                for (size_t k = begin; k < n; ++k) {
+                        const Event& e = t->events[k % ThreadTrace::capacity];
+                        std::fprintf(f, "%s{\"name\": ", first ? "" : ",\n");
+                        write_json_string(f, e.name);
+                        std::fprintf(f, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                                     "\"ts\": %.3f, \"dur\": %.3f}",
+                                     t->tid, e.start/1e3, (e.end - e.start)/1e3);
+                        first = false;
+                }
+        }
+        std::fprintf(f, "\n]}\n");
+
+        return std::fclose(f) == 0;
+}
+
+void clear_trace()
+{
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        for (size_t i = 0; registry && i < registry->size(); ++i)
+                (*registry)[i]->n_written.store(0, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,514 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "warp.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+using std::floor;
+using std::memset;
+using std::vector;
+
+namespace ceng391 {
+
+typedef long long int64;
+
+Transform::Transform()
+{
+        for (int k = 0; k < 9; ++k)
+                m[k] = k % 4 == 0 ? 1.0 : 0.0;
+}
+
+Transform Transform::affine(const double a[6])
+{
+        Transform t;
+        for (int k = 0; k < 6; ++k)
+                t.m[k] = a[k];
+        return t;
+}
+
+Transform Transform::homography(const double h[9])
+{
+        Transform t;
+        for (int k = 0; k < 9; ++k)
+                t.m[k] = h[k];
+        return t;
+}
+
+Transform Transform::translation(double tx, double ty)
+{
+        Transform t;
+        t.m[2] = tx;
+        t.m[5] = ty;
+        return t;
+}
+
+Transform Transform::rotation(double angle, double cx, double cy,
+                              double new_cx, double new_cy)
+{
+        const double radians = angle*std::acos(-1.0)/180.0;
+        const double c = std::cos(radians);
+        const double s = std::sin(radians);
+
+        // y points down, so this turns clockwise on screen
+        Transform t;
+        t.m[0] = c;
+        t.m[1] = -s;
+        t.m[2] = new_cx - c*cx + s*cy;
+        t.m[3] = s;
+        t.m[4] = c;
+        t.m[5] = new_cy - s*cx - c*cy;
+        return t;
+}
+
+// The inverse of a singular map is all zeros, which maps every point to
+// infinity.
+Transform Transform::inverse() const
+{
+        Transform r;
+        r.m[0] = m[4]*m[8] - m[5]*m[7];
+        r.m[1] = m[2]*m[7] - m[1]*m[8];
+        r.m[2] = m[1]*m[5] - m[2]*m[4];
+        r.m[3] = m[5]*m[6] - m[3]*m[8];
+        r.m[4] = m[0]*m[8] - m[2]*m[6];
+        r.m[5] = m[2]*m[3] - m[0]*m[5];
+        r.m[6] = m[3]*m[7] - m[4]*m[6];
+        r.m[7] = m[1]*m[6] - m[0]*m[7];
+        r.m[8] = m[0]*m[4] - m[1]*m[3];
+
+        const double det = m[0]*r.m[0] + m[1]*r.m[3] + m[2]*r.m[6];
+        for (int k = 0; k < 9; ++k)
+                r.m[k] = det != 0.0 ? r.m[k]/det : 0.0;
+        if (det != 0.0 && is_affine()) {
+                r.m[6] = 0.0;
+                r.m[7] = 0.0;
+                r.m[8] = 1.0;
+        }
+        return r;
+}
+
+Transform Transform::operator*(const Transform& o) const
+{
+        Transform r;
+        for (int i = 0; i < 3; ++i)
+                for (int j = 0; j < 3; ++j)
+                        r.m[3*i + j] = m[3*i]*o.m[j] + m[3*i + 1]*o.m[3 + j] + m[3*i + 2]*o.m[6 + j];
+        return r;
+}
+
+bool Transform::apply(double x, double y, double* x_out, double* y_out) const
+{
+        double w = m[6]*x + m[7]*y + m[8];
+        if (w <= 0.0)
+                return false;
+        *x_out = (m[0]*x + m[1]*y + m[2])/w;
+        *y_out = (m[3]*x + m[4]*y + m[5])/w;
+        return true;
+}
+
+Canvas warp_bounds(const Transform& t, int src_w, int src_h)
+{
+        Canvas c = { 0, 0, 0, 0 };
+        if (src_w <= 0 || src_h <= 0)
+                return c;
+
+        double x_min = 0.0, x_max = 0.0, y_min = 0.0, y_max = 0.0;
+        for (int k = 0; k < 4; ++k) {
+                double x, y;
+                if (!t.apply(k & 1 ? src_w - 1 : 0, k & 2 ? src_h - 1 : 0, &x, &y))
+                        return c;
+                if (k == 0 || x < x_min) x_min = x;
+                if (k == 0 || x > x_max) x_max = x;
+                if (k == 0 || y < y_min) y_min = y;
+                if (k == 0 || y > y_max) y_max = y;
+        }
+
+        // a little slack so that exact right angles do not grow by a pixel
+        const double eps = 1e-6;
+        c.x = (int) floor(x_min + eps);
+        c.y = (int) floor(y_min + eps);
+        c.w = (int) std::ceil(x_max - eps) - c.x + 1;
+        c.h = (int) std::ceil(y_max - eps) - c.y + 1;
+        return c;
+}
+
+// Affine maps step source coordinates with 32 fractional bits, which keeps
+// the rounding drift along a row far below the 8-bit sample weights.
+static const int coord_bits = 32;
+static const double coord_one = 4294967296.0;
+
+static int64 floor_div(int64 a, int64 b)
+{
+        int64 q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+// Narrows [*first, *last) to the j with 0 <= a + j*d <= hi.
+static void clip_span(int64 a, int64 d, int64 hi, int* first, int* last)
+{
+        int64 lo_j;
+        int64 hi_j;
+        if (d == 0) {
+                if (a < 0 || a > hi)
+                        *last = *first;
+                return;
+        }
+        if (d > 0) {
+                lo_j = -floor_div(a, d);         // ceil(-a / d)
+                hi_j = floor_div(hi - a, d);
+        } else {
+                lo_j = -floor_div(hi - a, -d);   // ceil((a - hi) / -d)
+                hi_j = floor_div(a, -d);
+        }
+        if (lo_j > *first)
+                *first = lo_j > *last ? *last : (int) lo_j;
+        if (hi_j + 1 < *last)
+                *last = hi_j + 1 < *first ? *first : (int) (hi_j + 1);
+}
+
+// Narrows [*first, *last) to the j with a + j*d >= 0.
+static void clip_linear(double a, double d, int* first, int* last)
+{
+        if (d == 0.0) {
+                if (a < 0.0)
+                        *last = *first;
+                return;
+        }
+        double j = -a/d;
+        if (d > 0.0) {
+                if (j > *first)
+                        *first = j >= *last ? *last : (int) std::ceil(j);
+        } else {
+                if (j + 1 < *last)
+                        *last = j + 1 < *first ? *first : (int) floor(j) + 1;
+        }
+}
+
+// Source position of output pixels in 24.8 fixed point, (column, row).
+class Mapping {
+public:
+        Mapping(const Transform& t, int src_w, int src_h, int origin_x, int origin_y)
+                : m_inv(t.inverse()), m_affine(m_inv.is_affine()),
+                  m_src_w(src_w), m_src_h(src_h), m_origin_x(origin_x), m_origin_y(origin_y)
+        {
+                m_du = (int64) floor(m_inv.m[0]*coord_one + 0.5);
+                m_dv = (int64) floor(m_inv.m[3]*coord_one + 0.5);
+        }
+
+        // Narrows [*first, *last) to the columns of row i that sample the
+        // source.
+        void clip(int i, int* first, int* last) const
+        {
+                if (m_src_w <= 0 || m_src_h <= 0) {
+                        *last = *first;
+                        return;
+                }
+
+                if (m_affine) {
+                        int64 u, v;
+                        row_start(i, &u, &v);
+                        clip_span(u, m_du, (int64) (m_src_w - 1) << coord_bits, first, last);
+                        clip_span(v, m_dv, (int64) (m_src_h - 1) << coord_bits, first, last);
+                        return;
+                }
+
+                // 0 <= X/W <= w - 1 with W > 0 is linear in the column
+                const double* m = m_inv.m;
+                const double x = m_origin_x;
+                const double y = i + m_origin_y;
+                const double a_x = m[0]*x + m[1]*y + m[2];
+                const double a_y = m[3]*x + m[4]*y + m[5];
+                const double a_w = m[6]*x + m[7]*y + m[8];
+                clip_linear(a_w - 1e-9, m[6], first, last);
+                clip_linear(a_x, m[0], first, last);
+                clip_linear((m_src_w - 1)*a_w - a_x, (m_src_w - 1)*m[6] - m[0], first, last);
+                clip_linear(a_y, m[3], first, last);
+                clip_linear((m_src_h - 1)*a_w - a_y, (m_src_h - 1)*m[6] - m[3], first, last);
+        }
+
+        // Calls f(j, u, v) for the columns [first, last) of row i, which
+        // must lie inside the span found by clip().
+        template <typename F>
+        void for_span(int i, int first, int last, const F& f) const
+        {
+                if (m_affine) {
+                        int64 u0, v0;
+                        row_start(i, &u0, &v0);
+                        int64 u = u0 + first*m_du;
+                        int64 v = v0 + first*m_dv;
+                        for (int j = first; j < last; ++j) {
+                                f(j, (int) (u >> (coord_bits - 8)), (int) (v >> (coord_bits - 8)));
+                                u += m_du;
+                                v += m_dv;
+                        }
+                        return;
+                }
+
+                const double* m = m_inv.m;
+                const double y = i + m_origin_y;
+                const int max_u = (m_src_w - 1) << 8;
+                const int max_v = (m_src_h - 1) << 8;
+                for (int j = first; j < last; ++j) {
+                        const double x = j + m_origin_x;
+                        const double w = 256.0/(m[6]*x + m[7]*y + m[8]);
+                        int u = (int) floor((m[0]*x + m[1]*y + m[2])*w + 0.5);
+                        int v = (int) floor((m[3]*x + m[4]*y + m[5])*w + 0.5);
+                        // the span is clipped in floating point, keep the
+                        // rounded position inside
+                        u = u < 0 ? 0 : (u > max_u ? max_u : u);
+                        v = v < 0 ? 0 : (v > max_v ? max_v : v);
+                        f(j, u, v);
+                }
+        }
+private:
+        void row_start(int i, int64* u, int64* v) const
+        {
+                const double* m = m_inv.m;
+                const double x = m_origin_x;
+                const double y = i + m_origin_y;
+                *u = (int64) floor((m[0]*x + m[1]*y + m[2])*coord_one + 0.5);
+                *v = (int64) floor((m[3]*x + m[4]*y + m[5])*coord_one + 0.5);
+        }
+
+        Transform m_inv;
+        bool m_affine;
+        int m_src_w;
+        int m_src_h;
+        int m_origin_x;
+        int m_origin_y;
+        int64 m_du;
+        int64 m_dv;
+};
+
+// Bilinear sample at column u and row v in 24.8 fixed point, inside the
+// image, of the N interleaved channels (src.n_ch() for N = 0). The
+// neighbours past the last row and column get a zero weight there, so they
+// are clamped instead of read.
+template <int N>
+static inline void sample(const ImageView& src, int u, int v, uchar* out)
+{
+        const int n = N > 0 ? N : src.n_ch();
+        const int x = u >> 8;
+        const int y = v >> 8;
+        const int fx = u & 255;
+        const int fy = v & 255;
+
+        const uchar* p = src.data(y) + x*n;
+        const uchar* q = y < src.h() - 1 ? p + src.step() : p;
+        const int right = x < src.w() - 1 ? n : 0;
+
+        for (int c = 0; c < n; ++c) {
+                int top = (p[c] << 8) + (p[c + right] - p[c])*fx;
+                int bottom = (q[c] << 8) + (q[c + right] - q[c])*fx;
+                out[c] = (uchar) (((top << 8) + (bottom - top)*fy + (1 << 15)) >> 16);
+        }
+}
+
+// Set and read from any thread, each warp() reads it once.
+static std::atomic<int> tile_size(64);
+
+void set_warp_tile_size(int size)
+{
+        tile_size.store(size > 0 ? size : 0, std::memory_order_relaxed);
+}
+
+int warp_tile_size()
+{
+        return tile_size.load(std::memory_order_relaxed);
+}
+
+// Runs clip(i, &first, &last) once per output row, fills the background
+// around the span and then calls fill(i, first, last, row) for the part of
+// the span inside each tile. Near 90 degrees a whole output row walks down
+// a source column, the tiles keep the source rows they read in cache.
+template <typename Clip, typename Fill>
+static void traverse_tiles(const ImageView& dst, uchar background,
+                           const Clip& clip, const Fill& fill)
+{
+        if (dst.w() <= 0 || dst.h() <= 0)
+                return;
+
+        const int n_ch = dst.n_ch();
+        const int tile = warp_tile_size();
+        const int band = tile > 0 ? tile : 1;
+        const int tile_w = tile > 0 ? tile : dst.w();
+        const int n_bands = (dst.h() + band - 1) / band;
+
+        parallel_for_rows(n_bands, [&](int b0, int b1) {
+                vector<int> firsts(band);
+                vector<int> lasts(band);
+                for (int b = b0; b < b1; ++b) {
+                        const int i0 = b*band;
+                        const int i1 = i0 + band < dst.h() ? i0 + band : dst.h();
+
+                        for (int i = i0; i < i1; ++i) {
+                                int first = 0;
+                                int last = dst.w();
+                                clip(i, &first, &last);
+                                firsts[i - i0] = first;
+                                lasts[i - i0] = last;
+
+                                uchar* row = dst.data(i);
+                                memset(row, background, (size_t) first*n_ch);
+                                memset(row + last*n_ch, background, (size_t) (dst.w() - last)*n_ch);
+                        }
+
+                        for (int j0 = 0; j0 < dst.w(); j0 += tile_w) {
+                                const int j1 = j0 + tile_w < dst.w() ? j0 + tile_w : dst.w();
+                                for (int i = i0; i < i1; ++i) {
+                                        int first = firsts[i - i0] > j0 ? firsts[i - i0] : j0;
+                                        int last = lasts[i - i0] < j1 ? lasts[i - i0] : j1;
+                                        if (first < last)
+                                                fill(i, first, last, dst.data(i));
+                                }
+                        }
+                }
+        });
+}
+
+template <int N>
+static void warp_channels(const ImageView& src, const ImageView& dst, const Mapping& map,
+                          uchar background)
+{
+        const int n = N > 0 ? N : src.n_ch();
+        traverse_tiles(dst, background,
+                       [&](int i, int* first, int* last) { map.clip(i, first, last); },
+                       [&](int i, int first, int last, uchar* row) {
+                               map.for_span(i, first, last, [&](int j, int u, int v) {
+                                       sample<N>(src, u, v, row + j*n);
+                               });
+                       });
+}
+
+void warp(const ImageView& src, const ImageView& dst, const Transform& t,
+          int origin_x, int origin_y, uchar background)
+{
+        TRACE_SCOPE("warp");
+        if (src.n_ch() != dst.n_ch())
+                return;
+
+        const Mapping map(t, src.w(), src.h(), origin_x, origin_y);
+        switch (src.n_ch()) {
+        case 1: warp_channels<1>(src, dst, map, background); break;
+        case 3: warp_channels<3>(src, dst, map, background); break;
+        case 4: warp_channels<4>(src, dst, map, background); break;
+        default: warp_channels<0>(src, dst, map, background); break;
+        }
+}
+
+RemapTable::RemapTable(const Transform& t, int src_w, int src_h, int dst_w, int dst_h,
+                       int origin_x, int origin_y)
+{
+        m_src_w = src_w;
+        m_src_h = src_h;
+        m_dst_w = dst_w > 0 ? dst_w : 0;
+        m_dst_h = dst_h > 0 ? dst_h : 0;
+        m_transform = t;
+        m_origin_x = origin_x;
+        m_origin_y = origin_y;
+        m_tabulated = src_w <= max_src_size && src_h <= max_src_size;
+        if (!m_tabulated)
+                return;
+
+        m_first.resize(m_dst_h);
+        m_last.resize(m_dst_h);
+        m_offset.resize(m_dst_h + 1);
+
+        const Mapping map(t, src_w, src_h, origin_x, origin_y);
+        size_t n = 0;
+        for (int i = 0; i < m_dst_h; ++i) {
+                m_first[i] = 0;
+                m_last[i] = m_dst_w;
+                map.clip(i, &m_first[i], &m_last[i]);
+                m_offset[i] = n;
+                n += m_last[i] - m_first[i];
+        }
+        m_offset[m_dst_h] = n;
+
+        m_entries.resize(n);
+        for (int i = 0; i < m_dst_h; ++i) {
+                Entry* e = m_entries.data() + m_offset[i];
+                const int first = m_first[i];
+                map.for_span(i, first, m_last[i], [&](int j, int u, int v) {
+                        Entry& entry = e[j - first];
+                        entry.x = (unsigned short) (u >> 8);
+                        entry.y = (unsigned short) (v >> 8);
+                        entry.fx = (uchar) (u & 255);
+                        entry.fy = (uchar) (v & 255);
+                });
+        }
+}
+
+size_t RemapTable::size_bytes() const
+{
+        return m_entries.size()*sizeof(Entry)
+                + (m_first.size() + m_last.size())*sizeof(int)
+                + m_offset.size()*sizeof(size_t);
+}
+
+template <int N>
+void RemapTable::apply_channels(const ImageView& src, const ImageView& dst, uchar background) const
+{
+        const int n = N > 0 ? N : src.n_ch();
+        traverse_tiles(dst, background,
+                       [&](int i, int* first, int* last) {
+                               *first = m_first[i];
+                               *last = m_last[i];
+                       },
+                       [&](int i, int first, int last, uchar* row) {
+                               const Entry* e = m_entries.data() + m_offset[i] + (first - m_first[i]);
+                               for (int j = first; j < last; ++j, ++e)
+                                       sample<N>(src, (e->x << 8) | e->fx, (e->y << 8) | e->fy, row + j*n);
+                       });
+}
+
+void RemapTable::apply(const ImageView& src, const ImageView& dst, uchar background) const
+{
+        TRACE_SCOPE("RemapTable::apply");
+        if (src.n_ch() != dst.n_ch())
+                return;
+        if (!m_tabulated) {
+                warp(src, dst, m_transform, m_origin_x, m_origin_y, background);
+                return;
+        }
+
+        switch (src.n_ch()) {
+        case 1: apply_channels<1>(src, dst, background); break;
+        case 3: apply_channels<3>(src, dst, background); break;
+        case 4: apply_channels<4>(src, dst, background); break;
+        default: apply_channels<0>(src, dst, background); break;
+        }
+}
+
+}
@@ -0,0 +1,154 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef WARP_H
+#define WARP_H
+
+#include <vector>
+
+#include "image.h"
+
+namespace ceng391 {
+
+// Projective map of pixel coordinates (x, y) = (column, row),
+//
+//     x' = (m[0] x + m[1] y + m[2]) / (m[6] x + m[7] y + m[8])
+//     y' = (m[3] x + m[4] y + m[5]) / (m[6] x + m[7] y + m[8])
+//
+// which is affine when the last row is 0 0 1.
+struct Transform {
+        Transform();
+
+        // From the top two rows of an affine matrix or a full homography,
+        // both in row major order.
+        static Transform affine(const double a[6]);
+        static Transform homography(const double h[9]);
+        static Transform translation(double tx, double ty);
+        // Clockwise rotation by angle degrees that moves (cx, cy) to
+        // (new_cx, new_cy).
+        static Transform rotation(double angle, double cx, double cy,
+                                  double new_cx, double new_cy);
+
+        bool is_affine() const { return m[6] == 0.0 && m[7] == 0.0 && m[8] == 1.0; }
+        Transform inverse() const;
+        // The map that applies o first and then this one.
+        Transform operator*(const Transform& o) const;
+        // Returns false for points that map to infinity or behind the
+        // camera of a homography.
+        bool apply(double x, double y, double* x_out, double* y_out) const;
+
+        double m[9];
+};
+
+// Placement of an output image in the coordinates a transform maps to:
+// output pixel (0, 0) is the point (x, y).
+struct Canvas {
+        int x;
+        int y;
+        int w;
+        int h;
+};
+
+// Smallest canvas holding the centers of all src_w x src_h pixels mapped by
+// t. Empty when a corner maps to infinity.
+Canvas warp_bounds(const Transform& t, int src_w, int src_h);
+
+// Bilinear warp of src into dst. Output pixel (x, y) shows the source point
+// that t maps to (x + origin_x, y + origin_y); pixels without one are set to
+// background. src and dst must have the same number of interleaved
+// channels; 1, 3 and 4 channels have their own inner loops.
+//
+// Affine maps step 32.32 fixed point source coordinates along each row and
+// clip the row against the source exactly before sampling, so the inner
+// loop has no bounds tests. Homographies clip each row the same way but
+// divide per pixel. The output is traversed in square tiles of
+// warp_tile_size() pixels so that the source rows a tile reads stay in
+// cache whatever the orientation.
+void warp(const ImageView& src, const ImageView& dst, const Transform& t,
+          int origin_x = 0, int origin_y = 0, uchar background = 0);
+
+// Side of the output tiles, 0 walks whole output rows. The default is 64.
+void set_warp_tile_size(int size);
+int warp_tile_size();
+
+// Source position of every output pixel of a fixed warp, computed once and
+// applied to any number of frames of the same size. Only pixels that sample
+// the source are stored, as 16-bit integer coordinates with 8-bit
+// fractions, six bytes per pixel. Sources with more than max_src_size
+// columns or rows do not fit these coordinates, their tables store nothing
+// and apply() warps directly.
+class RemapTable {
+public:
+        RemapTable(const Transform& t, int src_w, int src_h, int dst_w, int dst_h,
+                   int origin_x = 0, int origin_y = 0);
+
+        static const int max_src_size = 65536;
+
+        int src_w() const { return m_src_w; }
+        int src_h() const { return m_src_h; }
+        int dst_w() const { return m_dst_w; }
+        int dst_h() const { return m_dst_h; }
+        bool tabulated() const { return m_tabulated; }
+        std::size_t size_bytes() const;
+
+        // src and dst must have the sizes given to the constructor and the
+        // same number of channels.
+        void apply(const ImageView& src, const ImageView& dst, uchar background = 0) const;
+private:
+        template <int N>
+        void apply_channels(const ImageView& src, const ImageView& dst, uchar background) const;
+
+        struct Entry {
+                unsigned short x;
+                unsigned short y;
+                uchar fx;
+                uchar fy;
+        };
+
+        int m_src_w;
+        int m_src_h;
+        int m_dst_w;
+        int m_dst_h;
+        // kept for sources too large to tabulate
+        Transform m_transform;
+        int m_origin_x;
+        int m_origin_y;
+        bool m_tabulated;
+        // row i samples columns [m_first[i], m_last[i]) from the entries
+        // starting at m_offset[i]
+        std::vector<int> m_first;
+        std::vector<int> m_last;
+        std::vector<std::size_t> m_offset;
+        std::vector<Entry> m_entries;
+};
+
+}
+
+#endif
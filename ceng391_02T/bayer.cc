@@ -0,0 +1,549 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "bayer.h"
+#include "parallel.h"
+#include "trace.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+using std::cerr;
+using std::memcpy;
+using std::memset;
+using std::vector;
+
+namespace ceng391 {
+
+enum { red = 0, green = 1, blue = 2 };
+
+// colors of the 2x2 blocks, [pattern][y % 2][x % 2]
+static const int cfa[4][2][2] = {
+        { { red, green }, { green, blue } },
+        { { blue, green }, { green, red } },
+        { { green, red }, { blue, green } },
+        { { green, blue }, { red, green } }
+};
+
+BayerImage::BayerImage(int width, int height, BayerPattern pattern)
+        : Image(width, height, 1), m_pattern(pattern)
+{
+}
+
+int BayerImage::color(int x, int y) const
+{
+        return cfa[m_pattern][y & 1][x & 1];
+}
+
+BayerImage* BayerImage::from_rgb(const Image& rgb, BayerPattern pattern)
+{
+        TRACE_SCOPE("BayerImage::from_rgb");
+        if (rgb.n_ch() != 3) {
+                cerr << "[ERROR][CENG391::BayerImage] Only rgb images can be mosaiced!\n";
+                return 0;
+        }
+
+        BayerImage* mosaic = new BayerImage(rgb.w(), rgb.h(), pattern);
+        for (int y = 0; y < rgb.h(); ++y) {
+                const uchar* s = rgb.data(y);
+                uchar* d = mosaic->data(y);
+                const int c0 = cfa[pattern][y & 1][0];
+                const int c1 = cfa[pattern][y & 1][1];
+                int x = 0;
+                for (; x + 1 < rgb.w(); x += 2) {
+                        d[x] = s[3*x + c0];
+                        d[x + 1] = s[3*x + 3 + c1];
+                }
+                if (x < rgb.w())
+                        d[x] = s[3*x + c0];
+        }
+        return mosaic;
+}
+
+// Pixels outside the image mirror the ones inside without repeating the
+// edge, so that -1 maps to 1 and the filter colors stay in place.
+static int reflect(int i, int n)
+{
+        if (n == 1)
+                return 0;
+        while (i < 0 || i >= n)
+                i = i < 0 ? -i : 2*(n - 1) - i;
+        return i;
+}
+
+static const int pad = 2;
+
+// Rows y - 2 ... y + 2 of a gray image with pad mirrored pixels on both
+// sides, rolled down one row at a time. Rows are long enough for the
+// kernels to run over whole vectors past the right edge.
+class PaddedRows {
+public:
+        PaddedRows(const Image& img, int padded_w)
+                : m_img(img), m_buffer(5*padded_w, 0)
+        {
+                for (int k = 0; k < 5; ++k)
+                        m_rows[k] = &m_buffer[k*padded_w];
+        }
+
+        void start(int y)
+        {
+                m_y = y;
+                for (int k = 0; k < 5; ++k)
+                        load(m_rows[k], y - 2 + k);
+        }
+
+        void next()
+        {
+                uchar* oldest = m_rows[0];
+                for (int k = 0; k < 4; ++k)
+                        m_rows[k] = m_rows[k + 1];
+                m_rows[4] = oldest;
+                ++m_y;
+                load(m_rows[4], m_y + 2);
+        }
+
+        // row y + dy, pixel x at index x
+        const uchar* row(int dy) const { return m_rows[2 + dy] + pad; }
+private:
+        void load(uchar* dst, int y)
+        {
+                const int w = m_img.w();
+                const uchar* src = m_img.data(reflect(y, m_img.h()));
+                memcpy(dst + pad, src, w);
+                for (int i = 1; i <= pad; ++i) {
+                        dst[pad - i] = src[reflect(-i, w)];
+                        dst[pad + w - 1 + i] = src[reflect(w - 1 + i, w)];
+                }
+        }
+
+        const Image& m_img;
+        vector<uchar> m_buffer;
+        int m_y;
+        uchar* m_rows[5];
+};
+
+// How an output channel is obtained at a pixel from its neighbours.
+enum Source {
+        from_center,
+        from_horizontal,
+        from_vertical,
+        from_cross,
+        from_diagonal,
+        from_green
+};
+
+// Source of channel k at a pixel of color s in a row whose other color is
+// row_other.
+static Source source(int k, int s, int row_other)
+{
+        if (k == s)
+                return from_center;
+        if (s != green)
+                return k == green ? from_cross : from_diagonal;
+        return k == row_other ? from_horizontal : from_vertical;
+}
+
+// Sources of the three channels at the even and odd pixels of row y.
+struct RowSources {
+        RowSources(BayerPattern pattern, int y)
+        {
+                const int c0 = cfa[pattern][y & 1][0];
+                const int c1 = cfa[pattern][y & 1][1];
+                for (int k = 0; k < 3; ++k) {
+                        even[k] = source(k, c0, c1);
+                        odd[k] = source(k, c1, c0);
+                }
+        }
+
+        Source even[3];
+        Source odd[3];
+};
+
+static void interleave_rgb(const uchar* const* planes, uchar* dst, int width);
+
+// Padded rows hold whole vectors past the right edge.
+static int padded_width(int w)
+{
+        return (w + 15) / 16 * 16 + 2*pad + 16;
+}
+
+// Runs kernel(sources, rows, planes) for every row of src, in bands on the
+// thread pool, and interleaves the three planes it writes into dst.
+template <typename Kernel>
+static void demosaic_rows(const BayerImage& src, Image* dst, const Kernel& kernel)
+{
+        const int padded_w = padded_width(src.w());
+        parallel_for_rows(src.h(), [&](int y0, int y1) {
+                PaddedRows rows(src, padded_w);
+                vector<uchar> plane_buffer(3*padded_w);
+                uchar* planes[3];
+                for (int k = 0; k < 3; ++k)
+                        planes[k] = &plane_buffer[k*padded_w];
+
+                rows.start(y0);
+                for (int y = y0; y < y1; ++y) {
+                        if (y > y0)
+                                rows.next();
+                        kernel(RowSources(src.pattern(), y), rows, planes);
+                        interleave_rgb(planes, dst->data(y), src.w());
+                }
+        });
+}
+
+static inline int average2(int a, int b) { return (a + b + 1) >> 1; }
+static inline int average4(int a, int b, int c, int d) { return (a + b + c + d + 2) >> 2; }
+
+static inline uchar clamp(int v) { return (uchar) (v < 0 ? 0 : (v > 255 ? 255 : v)); }
+
+// Bilinear value of source s at pixel x of the middle row.
+static inline int bilinear(Source s, const uchar* up, const uchar* c, const uchar* down, int x)
+{
+        switch (s) {
+        case from_center: return c[x];
+        case from_horizontal: return average2(c[x - 1], c[x + 1]);
+        case from_vertical: return average2(up[x], down[x]);
+        case from_cross: return average4(c[x - 1], c[x + 1], up[x], down[x]);
+        default: return average4(up[x - 1], up[x + 1], down[x - 1], down[x + 1]);
+        }
+}
+
+#if defined(__SSE2__)
+
+// Eight pixels as 16-bit lanes.
+static inline __m128i load8(const uchar* p)
+{
+        return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) p), _mm_setzero_si128());
+}
+
+static inline void store8(uchar* p, __m128i v)
+{
+        _mm_storel_epi64((__m128i*) p, _mm_packus_epi16(v, v));
+}
+
+// Takes the even lanes from a and the odd lanes from b.
+static inline __m128i blend_even_odd(__m128i a, __m128i b)
+{
+        const __m128i even = _mm_set_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+        return _mm_or_si128(_mm_and_si128(even, a), _mm_andnot_si128(even, b));
+}
+
+static inline __m128i average2(__m128i a, __m128i b)
+{
+        return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(a, b), _mm_set1_epi16(1)), 1);
+}
+
+static inline __m128i average4(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+        __m128i sum = _mm_add_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, d));
+        return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+#endif
+
+static void bilinear_row(const RowSources& s, const PaddedRows& rows, uchar* const* planes, int w)
+{
+        const uchar* up = rows.row(-1);
+        const uchar* c = rows.row(0);
+        const uchar* down = rows.row(1);
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x < w; x += 8) {
+                __m128i v[6];
+                v[from_center] = load8(c + x);
+                const __m128i left = load8(c + x - 1);
+                const __m128i right = load8(c + x + 1);
+                const __m128i u = load8(up + x);
+                const __m128i d = load8(down + x);
+                v[from_horizontal] = average2(left, right);
+                v[from_vertical] = average2(u, d);
+                v[from_cross] = average4(left, right, u, d);
+                v[from_diagonal] = average4(load8(up + x - 1), load8(up + x + 1),
+                                            load8(down + x - 1), load8(down + x + 1));
+                for (int k = 0; k < 3; ++k)
+                        store8(planes[k] + x, blend_even_odd(v[s.even[k]], v[s.odd[k]]));
+        }
+#endif
+        for (; x < w; ++x)
+                for (int k = 0; k < 3; ++k)
+                        planes[k][x] = (uchar) bilinear((x & 1) ? s.odd[k] : s.even[k], up, c, down, x);
+}
+
+Image* BayerImage::demosaic_bilinear() const
+{
+        TRACE_SCOPE("demosaic_bilinear");
+        Image* rgb = new Image(w(), h(), 3);
+        demosaic_rows(*this, rgb, [&](const RowSources& s, const PaddedRows& rows, uchar* const* planes) {
+                bilinear_row(s, rows, planes, w());
+        });
+        return rgb;
+}
+
+// Green at pixel x of a red or blue row of the mosaic. The estimate along
+// each axis is the mean of the two green neighbours plus a quarter of the
+// curvature of the sampled color. The axis with the smaller gradient wins,
+// both are averaged on a tie.
+static inline int edge_green(const PaddedRows& m, int x)
+{
+        const uchar* c = m.row(0);
+        const int curv_h = 2*c[x] - c[x - 2] - c[x + 2];
+        const int curv_v = 2*c[x] - m.row(-2)[x] - m.row(2)[x];
+        const int grad_h = std::abs(c[x - 1] - c[x + 1]) + std::abs(curv_h);
+        const int grad_v = std::abs(m.row(-1)[x] - m.row(1)[x]) + std::abs(curv_v);
+        const int g_h = (2*(c[x - 1] + c[x + 1]) + curv_h + 2) >> 2;
+        const int g_v = (2*(m.row(-1)[x] + m.row(1)[x]) + curv_v + 2) >> 2;
+        if (grad_h < grad_v)
+                return g_h;
+        if (grad_v < grad_h)
+                return g_v;
+        return (g_h + g_v + 1) >> 1;
+}
+
+#if defined(__SSE2__)
+
+static inline __m128i blend(__m128i mask, __m128i a, __m128i b)
+{
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i abs16(__m128i v)
+{
+        return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+// edge_green() for eight pixels, arithmetic shifts round like the scalar
+// version.
+static inline __m128i edge_green8(const PaddedRows& m, int x)
+{
+        const uchar* c = m.row(0) + x;
+        const __m128i center2 = _mm_slli_epi16(load8(c), 1);
+        const __m128i left = load8(c - 1);
+        const __m128i right = load8(c + 1);
+        const __m128i up = load8(m.row(-1) + x);
+        const __m128i down = load8(m.row(1) + x);
+        const __m128i curv_h = _mm_sub_epi16(center2, _mm_add_epi16(load8(c - 2), load8(c + 2)));
+        const __m128i curv_v = _mm_sub_epi16(center2, _mm_add_epi16(load8(m.row(-2) + x),
+                                                                    load8(m.row(2) + x)));
+        const __m128i grad_h = _mm_add_epi16(abs16(_mm_sub_epi16(left, right)), abs16(curv_h));
+        const __m128i grad_v = _mm_add_epi16(abs16(_mm_sub_epi16(up, down)), abs16(curv_v));
+        const __m128i two = _mm_set1_epi16(2);
+        const __m128i g_h = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(
+                _mm_slli_epi16(_mm_add_epi16(left, right), 1), curv_h), two), 2);
+        const __m128i g_v = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(
+                _mm_slli_epi16(_mm_add_epi16(up, down), 1), curv_v), two), 2);
+        const __m128i tie = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(g_h, g_v),
+                                                         _mm_set1_epi16(1)), 1);
+        __m128i g = blend(_mm_cmplt_epi16(grad_v, grad_h), g_v, tie);
+        return blend(_mm_cmplt_epi16(grad_h, grad_v), g_h, g);
+}
+
+#endif
+
+// First pass of the edge aware demosaic, the full green plane.
+static void green_row(const RowSources& s, const PaddedRows& m, uchar* green_row, int w)
+{
+        const bool even_green = s.even[green] == from_center;
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x < w; x += 8) {
+                __m128i g = edge_green8(m, x);
+                __m128i c = load8(m.row(0) + x);
+                store8(green_row + x, even_green ? blend_even_odd(c, g) : blend_even_odd(g, c));
+        }
+#endif
+        for (; x < w; ++x) {
+                const bool is_green = ((x & 1) == 0) == even_green;
+                green_row[x] = is_green ? m.row(0)[x] : clamp(edge_green(m, x));
+        }
+}
+
+// Second pass, red and blue from the differences between the mosaic and
+// green at the neighbours that sampled them. Only used where those are
+// known: the difference m - g is zero at green pixels and ignored there.
+static inline int edge_color(Source s, const PaddedRows& m, const PaddedRows& g, int x)
+{
+        const uchar* mu = m.row(-1);
+        const uchar* mc = m.row(0);
+        const uchar* md = m.row(1);
+        const uchar* gu = g.row(-1);
+        const uchar* gc = g.row(0);
+        const uchar* gd = g.row(1);
+        switch (s) {
+        case from_center: return mc[x];
+        case from_green: return gc[x];
+        case from_horizontal:
+                return gc[x] + ((mc[x - 1] - gc[x - 1] + mc[x + 1] - gc[x + 1]) >> 1);
+        case from_vertical:
+                return gc[x] + ((mu[x] - gu[x] + md[x] - gd[x]) >> 1);
+        default:
+                return gc[x] + ((mu[x - 1] - gu[x - 1] + mu[x + 1] - gu[x + 1]
+                                 + md[x - 1] - gd[x - 1] + md[x + 1] - gd[x + 1]) >> 2);
+        }
+}
+
+static void edge_color_row(const RowSources& rs, const PaddedRows& m, const PaddedRows& g,
+                           uchar* const* planes, int w)
+{
+        Source even[3], odd[3];
+        for (int k = 0; k < 3; ++k) {
+                even[k] = k == green ? from_green : rs.even[k];
+                odd[k] = k == green ? from_green : rs.odd[k];
+        }
+
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x < w; x += 8) {
+                __m128i diff[3][3];
+                for (int dy = -1; dy <= 1; ++dy)
+                        for (int dx = -1; dx <= 1; ++dx)
+                                diff[dy + 1][dx + 1] = _mm_sub_epi16(load8(m.row(dy) + x + dx),
+                                                                     load8(g.row(dy) + x + dx));
+                const __m128i gc = load8(g.row(0) + x);
+                __m128i v[6];
+                v[from_center] = load8(m.row(0) + x);
+                v[from_green] = gc;
+                v[from_horizontal] = _mm_add_epi16(gc, _mm_srai_epi16(
+                        _mm_add_epi16(diff[1][0], diff[1][2]), 1));
+                v[from_vertical] = _mm_add_epi16(gc, _mm_srai_epi16(
+                        _mm_add_epi16(diff[0][1], diff[2][1]), 1));
+                v[from_diagonal] = _mm_add_epi16(gc, _mm_srai_epi16(
+                        _mm_add_epi16(_mm_add_epi16(diff[0][0], diff[0][2]),
+                                      _mm_add_epi16(diff[2][0], diff[2][2])), 2));
+                for (int k = 0; k < 3; ++k)
+                        store8(planes[k] + x, blend_even_odd(v[even[k]], v[odd[k]]));
+        }
+#endif
+        for (; x < w; ++x)
+                for (int k = 0; k < 3; ++k)
+                        planes[k][x] = clamp(edge_color((x & 1) ? odd[k] : even[k], m, g, x));
+}
+
+Image* BayerImage::demosaic_edge_aware() const
+{
+        TRACE_SCOPE("demosaic_edge_aware");
+        const int padded_w = padded_width(w());
+        Image green_plane(w(), h(), 1);
+        parallel_for_rows(h(), [&](int y0, int y1) {
+                PaddedRows rows(*this, padded_w);
+                vector<uchar> out(padded_w);
+                rows.start(y0);
+                for (int y = y0; y < y1; ++y) {
+                        if (y > y0)
+                                rows.next();
+                        green_row(RowSources(m_pattern, y), rows, &out[0], w());
+                        memcpy(green_plane.data(y), &out[0], w());
+                }
+        });
+
+        Image* rgb = new Image(w(), h(), 3);
+        parallel_for_rows(h(), [&](int y0, int y1) {
+                PaddedRows m(*this, padded_w);
+                PaddedRows g(green_plane, padded_w);
+                vector<uchar> plane_buffer(3*padded_w);
+                uchar* planes[3];
+                for (int k = 0; k < 3; ++k)
+                        planes[k] = &plane_buffer[k*padded_w];
+
+                m.start(y0);
+                g.start(y0);
+                for (int y = y0; y < y1; ++y) {
+                        if (y > y0) {
+                                m.next();
+                                g.next();
+                        }
+                        edge_color_row(RowSources(m_pattern, y), m, g, planes, w());
+                        interleave_rgb(planes, rgb->data(y), w());
+                }
+        });
+        return rgb;
+}
+
+#if defined(__SSE2__)
+
+// Byte shuffles gathering 16 rgb pixels from the three planes, [v][k] picks
+// the bytes of output vector v that come from plane k.
+struct InterleaveMasks {
+        InterleaveMasks()
+        {
+                for (int v = 0; v < 3; ++v)
+                        for (int j = 0; j < 16; ++j)
+                                for (int k = 0; k < 3; ++k)
+                                        bytes[v][k][j] = (16*v + j) % 3 == k ? (char) ((16*v + j) / 3)
+                                                                             : (char) -1;
+        }
+
+        char bytes[3][3][16];
+};
+
+static const InterleaveMasks interleave_masks;
+
+__attribute__((target("ssse3")))
+static int interleave_rgb_ssse3(const uchar* const* planes, uchar* dst, int width)
+{
+        int i = 0;
+        for (; i + 16 <= width; i += 16) {
+                __m128i x[3];
+                for (int k = 0; k < 3; ++k)
+                        x[k] = _mm_loadu_si128((const __m128i*) (planes[k] + i));
+                for (int v = 0; v < 3; ++v) {
+                        __m128i y = _mm_setzero_si128();
+                        for (int k = 0; k < 3; ++k)
+                                y = _mm_or_si128(y, _mm_shuffle_epi8(x[k], _mm_loadu_si128(
+                                        (const __m128i*) interleave_masks.bytes[v][k])));
+                        _mm_storeu_si128((__m128i*) (dst + 3*i + 16*v), y);
+                }
+        }
+        return i;
+}
+
+#endif
+
+static void interleave_rgb(const uchar* const* planes, uchar* dst, int width)
+{
+        int i = 0;
+#if defined(__SSE2__)
+        static const bool ssse3 = __builtin_cpu_supports("ssse3");
+        if (ssse3)
+                i = interleave_rgb_ssse3(planes, dst, width);
+#endif
+        for (; i < width; ++i) {
+                dst[3*i] = planes[0][i];
+                dst[3*i + 1] = planes[1][i];
+                dst[3*i + 2] = planes[2][i];
+        }
+}
+
+}
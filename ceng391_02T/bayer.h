@@ -0,0 +1,74 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef BAYER_H
+#define BAYER_H
+
+#include "image.h"
+
+namespace ceng391 {
+
+// Color filter arrays by the colors of the top left 2x2 block, row by row.
+enum BayerPattern {
+        bayer_rggb,
+        bayer_bggr,
+        bayer_grbg,
+        bayer_gbrg
+};
+
+// Raw sensor image, one gray sample per pixel, taken through the red,
+// green or blue filter that pattern() puts at that pixel.
+class BayerImage : public Image {
+public:
+        BayerImage(int width, int height, BayerPattern pattern);
+
+        BayerPattern pattern() const { return m_pattern; }
+        // Channel sampled at (x, y), 0 red, 1 green and 2 blue.
+        int color(int x, int y) const;
+
+        // Mosaic of an rgb image, keeps the filtered channel at each pixel.
+        // Returns null for images that do not have 3 channels.
+        static BayerImage* from_rgb(const Image& rgb, BayerPattern pattern);
+
+        // Full rgb images. Bilinear averages the nearest samples of each
+        // missing color. Edge aware interpolates green along the direction
+        // with the smaller gradient, corrected by the curvature of the
+        // sampled color, and then red and blue from their differences to
+        // green, which keeps edges sharp and avoids most color fringes.
+        // Both work on rows in parallel; the image borders are mirrored.
+        Image* demosaic_bilinear() const;
+        Image* demosaic_edge_aware() const;
+private:
+        BayerPattern m_pattern;
+};
+
+}
+
+#endif
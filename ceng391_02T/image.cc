@@ -29,15 +29,28 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // ------------------------------
 #include "image.h"
+#include "parallel.h"
+#include "trace.h"
 
 #include <iostream>
-#include <fstream>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
-using std::ofstream;
-using std::ios;
 using std::cerr;
 using std::string;
 using std::cout;
+using std::memcpy;
+using std::memset;
 
 namespace ceng391 {
 
@@ -68,94 +81,221 @@ Image* Image::new_rgb(int width, int height)
         return new Image(width, height, 3);
 }
 
-void Image::set_rect(int x, int y, int width, int height, uchar value)
-{
-        if (x < 0) {
-                x = 0;
-                width += x;
+// One pixel repeated over 48 bytes, a whole number of 1, 3 and 4 channel
+// pixels and of 16 byte vectors, so rows are filled with plain stores.
+struct FillPattern {
+        FillPattern(const uchar* pixel, int n_ch)
+        {
+                m_n_ch = n_ch;
+                m_uniform = true;
+                for (int c = 1; c < n_ch; ++c)
+                        if (pixel[c] != pixel[0])
+                                m_uniform = false;
+                m_bytes[0] = pixel[0];
+                if (m_uniform)
+                        return;
+                for (int i = 0; i < pattern_size; i += n_ch)
+                        for (int c = 0; c < n_ch; ++c)
+                                m_bytes[i + c] = pixel[c];
         }
 
-        if (y < 0) {
-                y = 0;
-                height += y;
-        }
+        void fill(uchar* dst, int n_pixels) const
+        {
+                size_t n = (size_t) n_pixels*m_n_ch;
+                if (m_uniform) {
+                        memset(dst, m_bytes[0], n);
+                        return;
+                }
 
-        for (int j = y; j < y+height; ++j) {
-                if (j >= m_height)
-                        break;
-                uchar* row_data = data(j);
-                for (int i = x; i < x+width; ++i) {
-                        if (i >= m_width)
-                                break;
-                        for (int c = 0; c < m_n_channels; ++c)
-                                row_data[i*m_n_channels + c] = value;
+                size_t i = 0;
+#if defined(__SSE2__)
+                const __m128i p0 = _mm_loadu_si128((const __m128i*) m_bytes);
+                const __m128i p1 = _mm_loadu_si128((const __m128i*) (m_bytes + 16));
+                const __m128i p2 = _mm_loadu_si128((const __m128i*) (m_bytes + 32));
+                for (; i + pattern_size <= n; i += pattern_size) {
+                        _mm_storeu_si128((__m128i*) (dst + i), p0);
+                        _mm_storeu_si128((__m128i*) (dst + i + 16), p1);
+                        _mm_storeu_si128((__m128i*) (dst + i + 32), p2);
                 }
+#endif
+                for (; i + pattern_size <= n; i += pattern_size)
+                        memcpy(dst + i, m_bytes, pattern_size);
+                memcpy(dst + i, m_bytes, n - i);
         }
+
+        static const int pattern_size = 48;
+
+        uchar m_bytes[pattern_size];
+        int m_n_ch;
+        bool m_uniform;
+};
+
+bool Image::clip_rect(int* x, int* y, int* width, int* height) const
+{
+        int x1 = *x + *width < m_width ? *x + *width : m_width;
+        int y1 = *y + *height < m_height ? *y + *height : m_height;
+        if (*x < 0)
+                *x = 0;
+        if (*y < 0)
+                *y = 0;
+        *width = x1 - *x;
+        *height = y1 - *y;
+        return *width > 0 && *height > 0;
+}
+
+void Image::fill_rect(int x, int y, int width, int height, const uchar* pixel)
+{
+        if (!clip_rect(&x, &y, &width, &height))
+                return;
+
+        const FillPattern pattern(pixel, m_n_channels);
+        for (int j = y; j < y + height; ++j)
+                pattern.fill(data(j) + x*m_n_channels, width);
+}
+
+void Image::set_rect(int x, int y, int width, int height, uchar value)
+{
+        TRACE_SCOPE("set_rect");
+        if (!clip_rect(&x, &y, &width, &height))
+                return;
+
+        for (int j = y; j < y + height; ++j)
+                memset(data(j) + x*m_n_channels, value, (size_t) width*m_n_channels);
 }
 
 void Image::set_rect_rgb(int x , int y, int width, int height, uchar red, uchar green , uchar blue) {
+        TRACE_SCOPE("set_rect_rgb");
         if(m_n_channels == 1) {
                 set_rect(x,y,width,height, (red + green + blue) / 3);
         }
         else if(m_n_channels == 3) {
-                uchar rgb[] = {red, green, blue};
-                for(int j = y; j < y + height; ++j) {
-                        if(j >= m_height)
-                                break;
-                        uchar* row_data = data(j);
-                        for(int i = x; i < x + width; ++i) {
-                                if(i > m_width)
-                                        break;
-                                for(int c = 0; c < m_n_channels; ++c) 
-                                        row_data[i*m_n_channels + c] = rgb[c];
-                        }
-                }
+                const uchar rgb[] = {red, green, blue};
+                fill_rect(x, y, width, height, rgb);
         }
         else {
                 cerr << "Only grayscale and rgb images supoorted.";
         }
 }
 
+void Image::set_rects(const std::vector<Rect>& rects, bool parallel)
+{
+        TRACE_SCOPE("set_rects");
+        if (m_n_channels != 1 && m_n_channels != 3) {
+                cerr << "Only grayscale and rgb images supoorted.";
+                return;
+        }
+
+        std::vector<Rect> clipped;
+        clipped.reserve(rects.size());
+        for (size_t k = 0; k < rects.size(); ++k) {
+                Rect r = rects[k];
+                if (clip_rect(&r.x, &r.y, &r.width, &r.height))
+                        clipped.push_back(r);
+        }
+
+        // every band draws all rectangles in order on its own rows, so the
+        // result does not depend on the number of threads
+        std::function<void(int, int)> draw = [&](int y0, int y1) {
+                for (size_t k = 0; k < clipped.size(); ++k) {
+                        const Rect& r = clipped[k];
+                        const int first = r.y > y0 ? r.y : y0;
+                        const int last = r.y + r.height < y1 ? r.y + r.height : y1;
+                        if (first >= last)
+                                continue;
+
+                        const uchar rgb[] = {r.red, r.green, r.blue};
+                        const uchar gray = (r.red + r.green + r.blue) / 3;
+                        const FillPattern pattern(m_n_channels == 1 ? &gray : rgb, m_n_channels);
+                        for (int j = first; j < last; ++j)
+                                pattern.fill(data(j) + r.x*m_n_channels, r.width);
+                }
+        };
+        if (parallel)
+                parallel_for_rows(m_height, draw);
+        else
+                draw(0, m_height);
+}
+
+static bool writev_all(int fd, struct iovec* iov, int n_iov)
+{
+        while (n_iov > 0) {
+                ssize_t n = writev(fd, iov, n_iov);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return false;
+                }
+                while (n_iov > 0 && (size_t) n >= iov->iov_len) {
+                        n -= iov->iov_len;
+                        ++iov;
+                        --n_iov;
+                }
+                if (n_iov > 0) {
+                        iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                        iov->iov_len -= n;
+                }
+        }
+        return true;
+}
+
 bool Image::write_pnm(const std::string& filename) const
 {
-        string magic_head = "P5";
-        ofstream fout;
-        string extension = ".pgm";
-        string extended_name = filename;
-        
-        if (m_n_channels == 3) {
+        TRACE_SCOPE("write_pnm");
+        string magic_head;
+        string extended_name;
+        if (m_n_channels == 1) {
+                magic_head = "P5";
+                extended_name = filename + ".pgm";
+        } else if (m_n_channels == 3) {
                 magic_head = "P6";
-                extension = ".ppm";
-                extended_name += extension;
-                fout.open(extended_name.c_str(), ios::out | ios::binary);
-
-                fout << magic_head << "\n";
-                fout << m_width << " " << m_height << " 255\n";
-                for(int y = 0; y < m_height; ++y) {
-                        const uchar *row_data = data(y);
-                        fout.write(reinterpret_cast<const char*>(row_data), m_step * sizeof(uchar));
-                }
-               
+                extended_name = filename + ".ppm";
+        } else {
+                cerr << "[ERROR][CENG391::Image] Only grayscale and rgb images can be saved as PNM files!\n";
+                return false;
         }
-        else if(m_n_channels == 1) {
-                extension = ".pgm";
-                extended_name += extension;
-                fout.open(extended_name.c_str(), ios::out | ios::binary);
-
-                fout << magic_head << "\n";
-                fout << m_width << " " << m_height << " 255\n";
-                for (int y = 0; y < m_height; ++y) {
-                        const uchar *row_data = data(y);
-                        fout.write(reinterpret_cast<const char*>(row_data), m_width*sizeof(uchar));
-                }
+
+        int fd = open(extended_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+                cerr << "[ERROR][CENG391::Image] Could not open " << extended_name << " for writing!\n";
+                return false;
         }
-        else {
-                cerr << "Only rgb and grayscale images accepted";
+
+        char header[64];
+        int header_size = snprintf(header, sizeof(header), "%s\n%d %d 255\n",
+                                   magic_head.c_str(), m_width, m_height);
+
+        // rows are gathered into a single writev call per batch, or written
+        // in one piece together with the header when there is no padding
+        const size_t row_size = (size_t) m_width*m_n_channels;
+        const int max_iov = 256;
+        struct iovec iov[max_iov];
+        iov[0].iov_base = header;
+        iov[0].iov_len = header_size;
+        int n_iov = 1;
+        bool ok = true;
+        if ((size_t) m_step == row_size) {
+                iov[1].iov_base = const_cast<uchar*>(m_data);
+                iov[1].iov_len = row_size*m_height;
+                ok = writev_all(fd, iov, 2);
+        } else {
+                for (int y = 0; y < m_height && ok; ++y) {
+                        iov[n_iov].iov_base = const_cast<uchar*>(data(y));
+                        iov[n_iov].iov_len = row_size;
+                        if (++n_iov == max_iov || y == m_height - 1) {
+                                ok = writev_all(fd, iov, n_iov);
+                                n_iov = 0;
+                        }
+                }
+                if (ok && m_height == 0)
+                        ok = writev_all(fd, iov, n_iov);
         }
 
-        fout.close();
+        if (close(fd) != 0)
+                ok = false;
+        if (!ok)
+                cerr << "[ERROR][CENG391::Image] Could not write " << extended_name << "!\n";
 
-        return true;
+        return ok;
 }
 
 
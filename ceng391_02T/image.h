@@ -32,15 +32,30 @@
 #define IMAGE_H
 
 #include <string>
+#include <vector>
 
 #include "util.h"
 
 namespace ceng391 {
 
+// A filled rectangle for Image::set_rects(). Gray images get the mean of
+// the three colors, as with set_rect_rgb().
+struct Rect {
+        int x;
+        int y;
+        int width;
+        int height;
+        uchar red;
+        uchar green;
+        uchar blue;
+};
+
 class Image {
 public:
         Image(int width, int height, int n_channels, int step = -1);
-        ~Image();
+        // virtual so that derived images such as BayerImage can be deleted
+        // through an Image pointer
+        virtual ~Image();
 
         static Image* new_gray(int width, int height);
         static Image* new_rgb(int width, int height);
@@ -55,13 +70,22 @@ public:
         uchar*       data(int y)       { return m_data + y*m_step; }
         const uchar* data(int y) const { return m_data + y*m_step; }
 
+        // The rectangle is clipped to the image once, its rows are then
+        // filled with memset or a repeated pixel pattern.
         void set_rect(int x, int y, int width, int height, uchar value);
         void set_rect_rgb(int x , int y, int width, int height, uchar red, uchar green , uchar blue);
+        // Draws the rectangles in order, later ones cover earlier ones. With
+        // parallel set, bands of rows are drawn on the worker threads.
+        void set_rects(const std::vector<Rect>& rects, bool parallel = true);
         void set(uchar value) { set_rect(0, 0, m_width, m_height, value); }
         void set_zero() { set(0); }
  
         bool write_pnm(const std::string& filename) const;
 private:
+        // Clips the rectangle to the image, false when nothing is left.
+        bool clip_rect(int* x, int* y, int* width, int* height) const;
+        void fill_rect(int x, int y, int width, int height, const uchar* pixel);
+
         int m_width;
         int m_height;
         int m_n_channels;
@@ -0,0 +1,155 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bayer.h"
+#include "bench.h"
+#include "image.h"
+
+using std::string;
+using ceng391::BayerImage;
+using ceng391::Bench;
+using ceng391::BenchOptions;
+using ceng391::Image;
+using ceng391::Rect;
+using ceng391::uchar;
+
+static Image* synthetic(int width, int height, int n_ch)
+{
+        Image* img = new Image(width, height, n_ch);
+        for (int y = 0; y < height; ++y) {
+                uchar* row = img->data(y);
+                for (int x = 0; x < width*n_ch; ++x)
+                        row[x] = (uchar) ((x*7) ^ (y*13));
+        }
+        return img;
+}
+
+// Path for a scratch file, write_pnm() appends the extension.
+static string temp_base()
+{
+        char name[] = "/tmp/image-bench-XXXXXX";
+        int fd = mkstemp(name);
+        if (fd >= 0) {
+                close(fd);
+                unlink(name);
+        }
+        return name;
+}
+
+static void bench_input(Bench& bench, const string& name, Image* img)
+{
+        const int w = img->w();
+        const int h = img->h();
+        const int n_ch = img->n_ch();
+        const double mb = w*(double) h*n_ch/1e6;
+        const double pixels = w*(double) h;
+
+        if (bench.enabled("set_rect", mb))
+                bench.run("set_rect", name, w, h, n_ch, pixels, [&]() {
+                        img->set_rect(0, 0, w, h, 17);
+                });
+        if (n_ch == 3 && bench.enabled("set_rect_rgb", mb))
+                bench.run("set_rect_rgb", name, w, h, n_ch, pixels, [&]() {
+                        img->set_rect_rgb(0, 0, w, h, 17, 34, 51);
+                });
+
+        // a checker of 8x8 tiles, one call per tile or one batch
+        std::vector<Rect> tiles;
+        for (int y = 0; y < h; y += 8)
+                for (int x = 0; x < w; x += 8) {
+                        Rect r = { x, y, 8, 8, (uchar) x, (uchar) y, (uchar) (x ^ y) };
+                        tiles.push_back(r);
+                }
+        if (bench.enabled("set_rect_rgb_8x8", mb))
+                bench.run("set_rect_rgb_8x8", name, w, h, n_ch, pixels, [&]() {
+                        for (size_t i = 0; i < tiles.size(); ++i) {
+                                const Rect& r = tiles[i];
+                                img->set_rect_rgb(r.x, r.y, r.width, r.height, r.red, r.green, r.blue);
+                        }
+                });
+        if (bench.enabled("set_rects_8x8", mb))
+                bench.run("set_rects_8x8", name, w, h, n_ch, pixels, [&]() {
+                        img->set_rects(tiles);
+                });
+
+        // rgb input is sampled into a mosaic once, the demosaic makes the
+        // rgb image again
+        if (n_ch == 3 && (bench.enabled("demosaic_bilinear", 2*mb)
+                          || bench.enabled("demosaic_edge_aware", 3*mb))) {
+                BayerImage* mosaic = BayerImage::from_rgb(*img, ceng391::bayer_rggb);
+                if (bench.enabled("demosaic_bilinear", 2*mb))
+                        bench.run("demosaic_bilinear", name, w, h, n_ch, pixels, [&]() {
+                                delete mosaic->demosaic_bilinear();
+                        });
+                if (bench.enabled("demosaic_edge_aware", 3*mb))
+                        bench.run("demosaic_edge_aware", name, w, h, n_ch, pixels, [&]() {
+                                delete mosaic->demosaic_edge_aware();
+                        });
+                delete mosaic;
+        }
+
+        const string base = temp_base();
+        if (bench.enabled("write_pnm", mb))
+                bench.run("write_pnm", name, w, h, n_ch, pixels, [&]() {
+                        img->write_pnm(base);
+                });
+        unlink((base + (n_ch == 1 ? ".pgm" : ".ppm")).c_str());
+}
+
+// Times the operations of this homework on synthetic gray and rgb images of
+// the requested sizes. This homework has no PNM reader, so the house images
+// are not used.
+int main(int argc, char** argv)
+{
+        BenchOptions options;
+        if (!options.parse(argc, argv))
+                return EXIT_FAILURE;
+        Bench bench(options);
+
+        for (size_t i = 0; i < options.sizes.size(); ++i) {
+                const int side = options.sizes[i];
+                for (int n_ch = 1; n_ch <= 3; n_ch += 2) {
+                        if (side*(double) side*n_ch/1e6 > options.max_mb)
+                                continue;
+                        Image* img = synthetic(side, side, n_ch);
+                        bench_input(bench, n_ch == 1 ? "gray" : "rgb", img);
+                        delete img;
+                }
+        }
+
+        return EXIT_SUCCESS;
+}
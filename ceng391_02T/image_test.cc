@@ -30,12 +30,17 @@
 // ------------------------------
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
+#include "bayer.h"
 #include "image.h"
 
 using std::cout;
 using std::endl;
+using ceng391::BayerImage;
 using ceng391::Image;
+using ceng391::Rect;
+using ceng391::uchar;
 
 int main(int argc, char** argv)
 {
@@ -63,32 +68,47 @@ int main(int argc, char** argv)
         cout << "(" << bayer->w() << "x" << bayer->h() << ") channels: "
              << bayer->n_ch() << " step: " << bayer->step() << endl;
         bayer->set_zero();
-        int w_counter = 0;
-        int h_counter = 0;
-        for(int i = 0; i <= bayer->h(); i += 8) {
-                for(int j = 0; j <= bayer->w(); j += 8) {
-                        if(h_counter % 2 == 0) {
-                                if(w_counter % 2 == 0)
-                                        bayer->set_rect_rgb(j, i, 8, 8, 0, 0, 255);
-                                else 
-                                        bayer->set_rect_rgb(j, i, 8, 8, 0, 255, 0);
+        // 8x8 tiles of a BGGR mosaic, drawn with a single call
+        std::vector<Rect> tiles;
+        for (int i = 0; i < bayer->h(); i += 8) {
+                for (int j = 0; j < bayer->w(); j += 8) {
+                        Rect r = { j, i, 8, 8, 0, 255, 0 };
+                        if ((i / 8) % 2 == 0 && (j / 8) % 2 == 0) {
+                                r.green = 0;
+                                r.blue = 255;
+                        } else if ((i / 8) % 2 == 1 && (j / 8) % 2 == 1) {
+                                r.green = 0;
+                                r.red = 255;
                         }
-                        else {
-                                if(w_counter % 2 == 0) {
-                                        bayer->set_rect_rgb(j, i , 8, 8, 0, 255, 0);
-                                }
-                                else {
-                                        bayer->set_rect_rgb(j, i, 8, 8, 255, 0, 0);
-                                }
-                        }        
-                        w_counter += 1;
+                        tiles.push_back(r);
                 }
-                h_counter += 1;
-                w_counter = 0;
         }
+        bayer->set_rects(tiles);
         bayer->write_pnm("/tmp/test_bayer");
         delete bayer;
 
+// Sampling a color gradient through an RGGB filter and demosaicing it
+        Image* scene = Image::new_rgb(256, 256);
+        for (int y = 0; y < scene->h(); ++y) {
+                uchar* row = scene->data(y);
+                for (int x = 0; x < scene->w(); ++x) {
+                        row[3*x] = (uchar) x;
+                        row[3*x + 1] = (uchar) y;
+                        row[3*x + 2] = (uchar) (255 - x);
+                }
+        }
+        scene->set_rect_rgb(64, 64, 128, 128, 255, 255, 255);
+        BayerImage* mosaic = BayerImage::from_rgb(*scene, ceng391::bayer_rggb);
+        mosaic->write_pnm("/tmp/test_mosaic");
+        Image* demosaiced = mosaic->demosaic_bilinear();
+        demosaiced->write_pnm("/tmp/test_demosaic_bilinear");
+        delete demosaiced;
+        demosaiced = mosaic->demosaic_edge_aware();
+        demosaiced->write_pnm("/tmp/test_demosaic_edge_aware");
+        delete demosaiced;
+        delete mosaic;
+        delete scene;
+
         return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,250 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "parallel.h"
+#include "trace.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ceng391 {
+
+class ThreadPool {
+public:
+        explicit ThreadPool(int n_workers);
+        ~ThreadPool();
+
+        int size() const { return (int) m_workers.size(); }
+
+        // Runs task(0) .. task(n_tasks - 1) on the workers and the calling
+        // thread. Returns false without running anything when the pool is
+        // already busy.
+        bool run(int n_tasks, const std::function<void(int)>& task);
+private:
+        void work();
+        void drain(const std::function<void(int)>* task, int n_tasks);
+
+        std::vector<std::thread> m_workers;
+        std::mutex m_busy;
+        std::mutex m_mutex;
+        std::condition_variable m_start;
+        std::condition_variable m_done;
+        const std::function<void(int)>* m_task;
+        int m_n_tasks;
+        std::atomic<int> m_next;
+        int m_finished;
+        unsigned m_generation;
+        bool m_quit;
+};
+
+static thread_local bool in_parallel_body = false;
+
+ThreadPool::ThreadPool(int n_workers)
+{
+        m_task = 0;
+        m_n_tasks = 0;
+        m_next = 0;
+        m_finished = 0;
+        m_generation = 0;
+        m_quit = false;
+        for (int i = 0; i < n_workers; ++i)
+                m_workers.push_back(std::thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+        {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_quit = true;
+        }
+        m_start.notify_all();
+        for (size_t i = 0; i < m_workers.size(); ++i)
+                m_workers[i].join();
+}
+
+void ThreadPool::drain(const std::function<void(int)>* task, int n_tasks)
+{
+        in_parallel_body = true;
+        for (int i = m_next++; i < n_tasks; i = m_next++)
+                (*task)(i);
+        in_parallel_body = false;
+}
+
+bool ThreadPool::run(int n_tasks, const std::function<void(int)>& task)
+{
+        std::unique_lock<std::mutex> busy(m_busy, std::try_to_lock);
+        if (!busy.owns_lock())
+                return false;
+
+        {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_task = &task;
+                m_n_tasks = n_tasks;
+                m_next = 0;
+                m_finished = 0;
+                ++m_generation;
+        }
+        m_start.notify_all();
+
+        drain(&task, n_tasks);
+
+        // every worker checks in before the task can go out of scope
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_finished < size())
+                m_done.wait(lock);
+        m_task = 0;
+
+        return true;
+}
+
+void ThreadPool::work()
+{
+        unsigned seen = 0;
+        for (;;) {
+                const std::function<void(int)>* task;
+                int n_tasks;
+                {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        while (!m_quit && m_generation == seen)
+                                m_start.wait(lock);
+                        if (m_quit)
+                                return;
+                        seen = m_generation;
+                        task = m_task;
+                        n_tasks = m_n_tasks;
+                }
+
+                drain(task, n_tasks);
+
+                {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        ++m_finished;
+                }
+                m_done.notify_one();
+        }
+}
+
+static std::mutex pool_mutex;
+// never destroyed, a worker may still be running a body at exit
+static std::shared_ptr<ThreadPool>& pool = *new std::shared_ptr<ThreadPool>();
+static int pool_threads = 0;
+static int default_chunk_rows = 0;
+
+static int default_num_threads()
+{
+        const char* env = std::getenv("CENG391_NUM_THREADS");
+        if (env && std::atoi(env) > 0)
+                return std::atoi(env);
+
+        int n = (int) std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+}
+
+// The pool lives until exit and is only replaced by set_num_threads(). Callers
+// keep a reference while they use it, so a pool that is replaced while it
+// runs a loop is deleted once that loop is done.
+static std::shared_ptr<ThreadPool> get_pool()
+{
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (pool_threads == 0)
+                pool_threads = default_num_threads();
+        if (!pool)
+                pool = std::make_shared<ThreadPool>(pool_threads - 1);
+        return pool;
+}
+
+void set_num_threads(int n_threads)
+{
+        // joins the workers of the old pool outside the lock if this was
+        // its last user
+        std::shared_ptr<ThreadPool> old;
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (n_threads < 1)
+                n_threads = default_num_threads();
+        if (n_threads == pool_threads && pool)
+                return;
+
+        old.swap(pool);
+        pool_threads = n_threads;
+}
+
+int num_threads()
+{
+        return get_pool()->size() + 1;
+}
+
+void set_chunk_rows(int chunk_rows)
+{
+        default_chunk_rows = chunk_rows > 0 ? chunk_rows : 0;
+}
+
+int chunk_rows()
+{
+        return default_chunk_rows;
+}
+
+void parallel_for_rows(int n_rows, const std::function<void(int, int)>& body,
+                       int chunk_rows)
+{
+        if (n_rows <= 0)
+                return;
+
+        std::shared_ptr<ThreadPool> p;
+        if (!in_parallel_body)
+                p = get_pool();
+        if (chunk_rows <= 0)
+                chunk_rows = default_chunk_rows;
+        if (chunk_rows <= 0 && p)
+                chunk_rows = n_rows / (4*(p->size() + 1));
+        if (chunk_rows < 1)
+                chunk_rows = 1;
+
+        const int n_chunks = (n_rows + chunk_rows - 1) / chunk_rows;
+        if (!p || p->size() == 0 || n_chunks == 1) {
+                body(0, n_rows);
+                return;
+        }
+
+        std::function<void(int)> task = [&](int chunk) {
+                TRACE_SCOPE("parallel_for_rows chunk");
+                int first = chunk*chunk_rows;
+                int last = first + chunk_rows < n_rows ? first + chunk_rows : n_rows;
+                body(first, last);
+        };
+        if (!p->run(n_chunks, task))
+                body(0, n_rows);
+}
+
+}
@@ -0,0 +1,163 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ceng391 {
+
+PerfSample::PerfSample()
+{
+        for (int i = 0; i < n_perf_events; ++i)
+                count[i] = -1.0;
+}
+
+double PerfSample::ipc() const
+{
+        if (!has(perf_cycles) || !has(perf_instructions) || count[perf_cycles] <= 0.0)
+                return -1.0;
+        return count[perf_instructions]/count[perf_cycles];
+}
+
+#if defined(__linux__)
+
+static const unsigned long long event_config[n_perf_events] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+};
+
+PerfCounters::PerfCounters()
+{
+        for (int i = 0; i < n_perf_events; ++i) {
+                struct perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = event_config[i];
+                attr.disabled = 1;
+                attr.inherit = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                // more events than hardware counters are multiplexed,
+                // the times allow scaling the counts back
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+                        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                m_fd[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+                if (m_fd[i] < 0 && m_error.empty())
+                        m_error = std::strerror(errno);
+        }
+}
+
+PerfCounters::~PerfCounters()
+{
+        for (int i = 0; i < n_perf_events; ++i)
+                if (m_fd[i] >= 0)
+                        close(m_fd[i]);
+}
+
+bool PerfCounters::available() const
+{
+        for (int i = 0; i < n_perf_events; ++i)
+                if (m_fd[i] >= 0)
+                        return true;
+        return false;
+}
+
+void PerfCounters::start()
+{
+        for (int i = 0; i < n_perf_events; ++i) {
+                if (m_fd[i] < 0)
+                        continue;
+                ioctl(m_fd[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+}
+
+PerfSample PerfCounters::stop()
+{
+        PerfSample s;
+        for (int i = 0; i < n_perf_events; ++i)
+                if (m_fd[i] >= 0)
+                        ioctl(m_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        for (int i = 0; i < n_perf_events; ++i) {
+                unsigned long long v[3];
+                if (m_fd[i] < 0 || read(m_fd[i], v, sizeof(v)) != (ssize_t) sizeof(v))
+                        continue;
+                // v = {value, time enabled, time running}
+                if (v[2] == 0)
+                        continue;
+                s.count[i] = v[2] < v[1] ? (double) v[0]*v[1]/v[2] : (double) v[0];
+        }
+        return s;
+}
+
+#else
+
+PerfCounters::PerfCounters()
+        : m_error("perf events are only supported on Linux")
+{
+        for (int i = 0; i < n_perf_events; ++i)
+                m_fd[i] = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+bool PerfCounters::available() const
+{
+        return false;
+}
+
+void PerfCounters::start()
+{
+}
+
+PerfSample PerfCounters::stop()
+{
+        return PerfSample();
+}
+
+#endif
+
+}
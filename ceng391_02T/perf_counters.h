@@ -0,0 +1,84 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <string>
+
+namespace ceng391 {
+
+enum PerfEvent {
+        perf_cycles = 0,
+        perf_instructions,
+        perf_llc_misses,
+        perf_branch_misses,
+        n_perf_events
+};
+
+// Counts accumulated between PerfCounters::start() and stop(). Events the
+// machine does not provide are negative.
+struct PerfSample {
+        PerfSample();
+
+        bool has(PerfEvent e) const { return count[e] >= 0.0; }
+        // instructions per cycle, negative when unknown
+        double ipc() const;
+
+        double count[n_perf_events];
+};
+
+// Hardware counters of the calling thread and of the threads it creates
+// after construction, so counting also covers a thread pool that is started
+// later. Uses perf_event_open on Linux; when that is not permitted or the
+// hardware events do not exist (virtual machines, containers,
+// perf_event_paranoid) available() is false and samples stay empty.
+class PerfCounters {
+public:
+        PerfCounters();
+        ~PerfCounters();
+
+        bool available() const;
+        // why the counters are not available
+        const std::string& error() const { return m_error; }
+
+        void start();
+        PerfSample stop();
+private:
+        PerfCounters(const PerfCounters&);
+        PerfCounters& operator=(const PerfCounters&);
+
+        int m_fd[n_perf_events];
+        std::string m_error;
+};
+
+}
+
+#endif
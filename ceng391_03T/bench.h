@@ -0,0 +1,99 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ceng391 {
+
+class PerfCounters;
+
+// Command line options shared by the image-bench targets.
+struct BenchOptions {
+        BenchOptions();
+
+        // Parses the arguments, prints the usage and returns false on
+        // errors or --help.
+        bool parse(int argc, char** argv);
+
+        // sides of the synthetic square images
+        std::vector<int> sizes;
+        // every case runs at least min_runs times and min_time seconds
+        double min_time;
+        int min_runs;
+        // table, csv or json (one object per line)
+        std::string format;
+        // only cases whose operation name contains this
+        std::string filter;
+        // cases that need more memory are skipped
+        double max_mb;
+        // directory holding house.pgm and house.ppm
+        std::string images;
+        // also report hardware counters per case
+        bool counters;
+};
+
+// Times benchmark cases and prints one line of statistics per case.
+class Bench {
+public:
+        explicit Bench(const BenchOptions& options);
+        ~Bench();
+
+        const BenchOptions& options() const { return m_options; }
+
+        // True when op matches the filter and needs at most max_mb megabytes.
+        bool enabled(const std::string& op, double megabytes) const;
+
+        // Runs body once to warm up and then until both min_runs and
+        // min_time are reached. Reports the mean, minimum and spread of
+        // the run times, and the throughput for n_pixels pixels per run.
+        // With counters enabled also the instructions per cycle and the
+        // last level cache and branch misses per pixel over all runs.
+        void run(const std::string& op, const std::string& input,
+                 int width, int height, int n_ch, double n_pixels,
+                 const std::function<void()>& body);
+private:
+        Bench(const Bench&);
+        Bench& operator=(const Bench&);
+
+        void print_header();
+
+        BenchOptions m_options;
+        PerfCounters* m_counters;
+        bool m_printed_header;
+};
+
+}
+
+#endif
@@ -29,13 +29,18 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // ------------------------------
 #include "image.h"
+#include "point_op.h"
+#include "trace.h"
 
 #include <iostream>
-#include <fstream>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
 
-using std::ofstream;
-using std::ios;
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
 using std::cerr;
 using std::string;
 
@@ -51,7 +56,7 @@ Image::Image(int width, int height, int n_channels, int step)
         m_step = m_width*m_n_channels;
         if (m_step < step)
                 m_step = step;
-        m_data = new uchar[m_step*height];
+        m_data = new uchar[(size_t) m_step*height];
 
      
 }
@@ -73,71 +78,132 @@ Image* Image::new_rgb(int width, int height)
 
 void Image::set_rect(int x, int y, int width, int height, uchar value)
 {
-        if (x < 0) {
+        TRACE_SCOPE("set_rect");
+        const int x1 = x + width < m_width ? x + width : m_width;
+        const int y1 = y + height < m_height ? y + height : m_height;
+        if (x < 0)
                 x = 0;
-                width += x;
-        }
-
-        if (y < 0) {
+        if (y < 0)
                 y = 0;
-                height += y;
+        if (x >= x1 || y >= y1)
+                return;
+
+        for (int j = y; j < y1; ++j)
+                memset(data(j) + x*m_n_channels, value, (size_t) (x1 - x)*m_n_channels);
+}
+
+bool Image::transform(float alpha, int c, Image* dst) const
+{
+        TRACE_SCOPE("Image::transform");
+        if (dst->m_width != m_width || dst->m_height != m_height
+            || dst->m_n_channels != m_n_channels) {
+                cerr << "[ERROR][CENG391::Image] Transform target does not match the source image size!\n";
+                return false;
         }
 
-        for (int j = y; j < y+height; ++j) {
-                if (j >= m_height)
-                        break;
-                uchar* row_data = data(j);
-                for (int i = x; i < x+width; ++i) {
-                        if (i >= m_width)
-                                break;
-                        for (int c = 0; c < m_n_channels; ++c)
-                                row_data[i*m_n_channels + c] = value;
-                }
+        const PointOp op(alpha, c);
+        const size_t row_size = (size_t) m_width*m_n_channels;
+        if ((size_t) m_step == row_size && (size_t) dst->m_step == row_size) {
+                point_op_row(op, m_data, dst->m_data, row_size*m_height);
+                return true;
         }
-   //   transformImage(1.5, 0);
+
+        for (int y = 0; y < m_height; ++y)
+                point_op_row(op, data(y), dst->data(y), row_size);
+
+        return true;
 }
 
 uchar* Image::transformImage(float alpha, int c) {
-        uchar* datam = new uchar[m_step * m_height]; 
-        memcpy(datam, m_data, sizeof(uchar) * m_step * m_height);
-        
-        for(int i = 0; i < m_height; i++) {
-                uchar* row_data = datam + (m_step * i);
-                for(int j = 0; j < m_width; j++) {     
-                        int row_int = (int) row_data[j];
-                        row_int = (row_int * alpha) + c;
-                   
-                        if(row_int > 255)
-                                row_data[j] = 255;
-                        else if(row_int < 0)
-                                row_data[j] = 0;
-                        else
-                                row_data[j] = row_int;
+        TRACE_SCOPE("transformImage");
+        uchar* datam = new uchar[(size_t) m_step*m_height];
+        const PointOp op(alpha, c);
+        for (int y = 0; y < m_height; ++y)
+                point_op_row(op, data(y), datam + (size_t) y*m_step, (size_t) m_width*m_n_channels);
+
+        return datam;
+}
+
+static bool writev_all(int fd, struct iovec* iov, int n_iov)
+{
+        while (n_iov > 0) {
+                ssize_t n = writev(fd, iov, n_iov);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return false;
+                }
+                while (n_iov > 0 && (size_t) n >= iov->iov_len) {
+                        n -= iov->iov_len;
+                        ++iov;
+                        --n_iov;
+                }
+                if (n_iov > 0) {
+                        iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                        iov->iov_len -= n;
                 }
         }
-        return datam;
+        return true;
 }
 
 bool Image::write_pnm(const std::string& filename) const
-{ 
-        if (m_n_channels != 1) {
-                cerr << "[ERROR][CENG391::Image] Currently only grayscale images can be saved as PNM files!\n";
+{
+        TRACE_SCOPE("write_pnm");
+        string magic_head;
+        string extended_name;
+        if (m_n_channels == 1) {
+                magic_head = "P5";
+                extended_name = filename + ".pgm";
+        } else if (m_n_channels == 3) {
+                magic_head = "P6";
+                extended_name = filename + ".ppm";
+        } else {
+                cerr << "[ERROR][CENG391::Image] Only grayscale and rgb images can be saved as PNM files!\n";
                 return false;
         }
 
-        const string magic_head = "P5";
-        ofstream fout;
-        string extended_name = filename + ".pgm";
-        fout.open(extended_name.c_str(), ios::out | ios::binary);
-        fout << magic_head << "\n";
-        fout << m_width << " " << m_height << " 255\n";
-        for (int y = 0; y < m_height; ++y) {
-                const uchar *row_data = data(y);
-                fout.write(reinterpret_cast<const char*>(row_data), m_width*sizeof(uchar));
+        int fd = open(extended_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+                cerr << "[ERROR][CENG391::Image] Could not open " << extended_name << " for writing!\n";
+                return false;
         }
-        fout.close();
 
-        return true;
+        char header[64];
+        int header_size = snprintf(header, sizeof(header), "%s\n%d %d 255\n",
+                                   magic_head.c_str(), m_width, m_height);
+
+        // rows are gathered into a single writev call per batch, or written
+        // in one piece together with the header when there is no padding
+        const size_t row_size = (size_t) m_width*m_n_channels;
+        const int max_iov = 256;
+        struct iovec iov[max_iov];
+        iov[0].iov_base = header;
+        iov[0].iov_len = header_size;
+        int n_iov = 1;
+        bool ok = true;
+        if ((size_t) m_step == row_size) {
+                iov[1].iov_base = const_cast<uchar*>(m_data);
+                iov[1].iov_len = row_size*m_height;
+                ok = writev_all(fd, iov, 2);
+        } else {
+                for (int y = 0; y < m_height && ok; ++y) {
+                        iov[n_iov].iov_base = const_cast<uchar*>(data(y));
+                        iov[n_iov].iov_len = row_size;
+                        if (++n_iov == max_iov || y == m_height - 1) {
+                                ok = writev_all(fd, iov, n_iov);
+                                n_iov = 0;
+                        }
+                }
+                if (ok && m_height == 0)
+                        ok = writev_all(fd, iov, n_iov);
+        }
+
+        if (close(fd) != 0)
+                ok = false;
+        if (!ok)
+                cerr << "[ERROR][CENG391::Image] Could not write " << extended_name << "!\n";
+
+        return ok;
 }
 
 
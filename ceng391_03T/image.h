@@ -31,6 +31,7 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <cstddef>
 #include <string>
 
 #include "util.h"
@@ -52,13 +53,18 @@ public:
 
         uchar*       data()       { return m_data; }
         const uchar* data() const { return m_data; }
-        uchar*       data(int y)       { return m_data + y*m_step; }
-        const uchar* data(int y) const { return m_data + y*m_step; }
+        uchar*       data(int y)       { return m_data + (std::size_t) y*m_step; }
+        const uchar* data(int y) const { return m_data + (std::size_t) y*m_step; }
 
         void set_rect(int x, int y, int width, int height, uchar value);
         void set(uchar value) { set_rect(0, 0, m_width, m_height, value); }
         void set_zero() { set(0); }
 
+        // Brightness/contrast point operation dst = sat(src * alpha + c)
+        // applied to every channel. dst must have the same size and number
+        // of channels and may be this image itself.
+        bool transform(float alpha, int c, Image* dst) const;
+        void transform(float alpha, int c) { transform(alpha, c, this); }
         uchar* transformImage(float alpha, int c);
 
         bool write_pnm(const std::string& filename) const;
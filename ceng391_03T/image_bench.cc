@@ -0,0 +1,116 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+#include "bench.h"
+#include "image.h"
+
+using std::string;
+using ceng391::Bench;
+using ceng391::BenchOptions;
+using ceng391::Image;
+using ceng391::uchar;
+
+static Image* synthetic(int width, int height, int n_ch)
+{
+        Image* img = new Image(width, height, n_ch);
+        for (int y = 0; y < height; ++y) {
+                uchar* row = img->data(y);
+                for (int x = 0; x < width*n_ch; ++x)
+                        row[x] = (uchar) ((x*7) ^ (y*13));
+        }
+        return img;
+}
+
+// Path for a scratch file, write_pnm() appends the extension.
+static string temp_base()
+{
+        char name[] = "/tmp/image-bench-XXXXXX";
+        int fd = mkstemp(name);
+        if (fd >= 0) {
+                close(fd);
+                unlink(name);
+        }
+        return name;
+}
+
+static void bench_input(Bench& bench, const string& name, Image* img)
+{
+        const int w = img->w();
+        const int h = img->h();
+        const int n_ch = img->n_ch();
+        const double mb = w*(double) h*n_ch/1e6;
+        const double pixels = w*(double) h;
+
+        if (bench.enabled("transformImage", 2*mb))
+                bench.run("transformImage", name, w, h, n_ch, pixels, [&]() {
+                        delete [] img->transformImage(1.2f, 10);
+                });
+        if (bench.enabled("transform_in_place", mb))
+                bench.run("transform_in_place", name, w, h, n_ch, pixels, [&]() {
+                        img->transform(1.0f, 1);
+                });
+
+        const string base = temp_base();
+        if (bench.enabled("write_pnm", mb))
+                bench.run("write_pnm", name, w, h, n_ch, pixels, [&]() {
+                        img->write_pnm(base);
+                });
+        unlink((base + (n_ch == 1 ? ".pgm" : ".ppm")).c_str());
+}
+
+// Times the operations of this homework on synthetic gray and rgb images of
+// the requested sizes. This homework has no PNM reader, so the house images
+// are not used.
+int main(int argc, char** argv)
+{
+        BenchOptions options;
+        if (!options.parse(argc, argv))
+                return EXIT_FAILURE;
+        Bench bench(options);
+
+        for (size_t i = 0; i < options.sizes.size(); ++i) {
+                const int side = options.sizes[i];
+                for (int n_ch = 1; n_ch <= 3; n_ch += 2) {
+                        if (side*(double) side*n_ch/1e6 > options.max_mb)
+                                continue;
+                        Image* img = synthetic(side, side, n_ch);
+                        bench_input(bench, n_ch == 1 ? "gray" : "rgb", img);
+                        delete img;
+                }
+        }
+
+        return EXIT_SUCCESS;
+}
@@ -29,30 +29,37 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // ------------------------------
 #include "image_window.h"
+#include "trace.h"
 
 #include <iostream>
 #include <QApplication>
+#include <QPainter>
 
 using std::cerr;
 using std::endl;
 
 namespace ceng391 {
 
-static QImage* convert_to_qimage(Image* img);
+static QImage wrap_qimage(Image* img);
 
 ImageWindow::ImageWindow(const QString &title, Image *img)
 {
         m_image = img;
+        m_worker = 0;
+        for (int i = 0; i < RenderWorker::n_surfaces; ++i)
+                m_surface[i] = 0;
         setWindowTitle(title);
 
-        m_label = new QLabel(this);
         if (img != 0) {
-                QImage* qimg = convert_to_qimage(img);
-                if (qimg != 0) {
-                        m_label->setPixmap(QPixmap::fromImage(*qimg));
-                        resize(img->w(), img->h() + 80);
-                        delete qimg;
+                for (int i = 0; i < RenderWorker::n_surfaces; ++i) {
+                        m_surface[i] = new Image(img->w(), img->h(), img->n_ch(), img->step());
+                        m_frame[i] = wrap_qimage(m_surface[i]);
                 }
+                m_worker = new RenderWorker(img, m_surface, this);
+                img->transform(1.0f, 0, m_surface[m_worker->front()]);
+                QObject::connect(m_worker, SIGNAL (frameReady()), this, SLOT (presentFrame()));
+                m_worker->start();
+                resize(img->w(), img->h() + 80);
         }
 
         m_brightness= new QScrollBar(this);
@@ -72,40 +79,69 @@ ImageWindow::ImageWindow(const QString &title, Image *img)
         QObject::connect(QApplication::instance(), SIGNAL (aboutToQuit()), this, SLOT (releaseData()));
 }
 
-QImage* convert_to_qimage(Image* img)
-{       
-        if (img->n_ch() == 1) { 
-                QImage *qimg = new QImage(img->data(), img->w(), img->h(), img->step(), QImage::Format_Grayscale8);
-                
-                return qimg;
+ImageWindow::~ImageWindow()
+{
+        delete m_worker;
+        for (int i = 0; i < RenderWorker::n_surfaces; ++i)
+                delete m_surface[i];
+}
+
+// Wraps the pixels of img without copying, img must outlive the result.
+QImage wrap_qimage(Image* img)
+{
+        if (img->n_ch() == 1) {
+                return QImage(img->data(), img->w(), img->h(), img->step(), QImage::Format_Grayscale8);
+        } else if (img->n_ch() == 3) {
+                return QImage(img->data(), img->w(), img->h(), img->step(), QImage::Format_RGB888);
         } else {
-                cerr << "[ERROR][ImageWindow] Can only load grayscale images!" << endl;
-                return 0;
+                cerr << "[ERROR][ImageWindow] Can only load grayscale and rgb images!" << endl;
+                return QImage();
         }
 }
 
+void ImageWindow::paintEvent(QPaintEvent *event)
+{
+        TRACE_SCOPE("ImageWindow::paintEvent");
+        if (m_worker == 0 || m_frame[m_worker->front()].isNull())
+                return;
+
+        QPainter painter(this);
+        painter.drawImage(event->rect().topLeft(), m_frame[m_worker->front()], event->rect());
+}
+
+void ImageWindow::render()
+{
+        TRACE_SCOPE("ImageWindow::render");
+        if (m_worker == 0)
+                return;
+
+        float alpha = m_contrast->value() * 0.01f;
+        m_worker->request(alpha, m_brightness->value());
+}
+
+void ImageWindow::presentFrame()
+{
+        TRACE_SCOPE("ImageWindow::presentFrame");
+        if (m_worker == 0)
+                return;
+
+        m_worker->present();
+        update(0, 0, m_surface[0]->w(), m_surface[0]->h());
+}
+
 void ImageWindow::changeBrightness(int value) {
-        uchar* transform_data = m_image->transformImage(m_contrast->value() * 0.01,value);
-        QImage *qimg = new QImage(transform_data, m_image->w(), m_image->h(), m_image->step(), QImage::Format_Grayscale8);
-        m_label->setPixmap(QPixmap::fromImage(*qimg));
-        
-        delete transform_data;
-        delete qimg;
+        render();
 }
 
 void ImageWindow::changeContrast(int value) {
-        float c_value = value * 0.01;
- 
-        uchar* transform_data = m_image->transformImage(c_value,m_brightness->value());
-        QImage *qimg = new QImage(transform_data, m_image->w(), m_image->h(), m_image->step(), QImage::Format_Grayscale8);
-        m_label->setPixmap(QPixmap::fromImage(*qimg));
-
-        delete transform_data;
-        delete qimg;
+        render();
 }
 
 void ImageWindow::releaseData() {
+       if (m_worker != 0)
+               m_worker->stop();
        delete m_image;
+       m_image = 0;
 }
 
 }
@@ -36,10 +36,11 @@
 #include <QObject>
 #include <QWidget>
 #include <QImage>
-#include <QLabel>
+#include <QPaintEvent>
 #include <QScrollBar>
 
 #include "image.h"
+#include "render_worker.h"
 
 namespace ceng391 {
 
@@ -47,13 +48,23 @@ class ImageWindow: public QWidget {
         Q_OBJECT
 public:
         ImageWindow(const QString &title,  Image *img);
+        ~ImageWindow();
+protected:
+        void paintEvent(QPaintEvent *event);
 private slots:
         void changeBrightness(int value);
         void changeContrast(int value);
         void releaseData();
+        void presentFrame();
 private:
+        void render();
+
         Image* m_image;
-        QLabel *m_label;
+        // Display surfaces are allocated once. Slider updates are rendered
+        // into them by the worker thread, the QImages only wrap the pixels.
+        Image* m_surface[RenderWorker::n_surfaces];
+        QImage m_frame[RenderWorker::n_surfaces];
+        RenderWorker* m_worker;
         QScrollBar* m_brightness;
         QScrollBar* m_contrast;
 };
@@ -0,0 +1,114 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#include "render_worker.h"
+
+namespace ceng391 {
+
+RenderWorker::RenderWorker(const Image* src, Image** surfaces, QObject* parent)
+        : QThread(parent)
+{
+        m_src = src;
+        for (int i = 0; i < n_surfaces; ++i)
+                m_surface[i] = surfaces[i];
+
+        m_pending = false;
+        m_quit = false;
+        m_alpha = 1.0f;
+        m_c = 0;
+        m_front = 0;
+        m_ready = -1;
+}
+
+RenderWorker::~RenderWorker()
+{
+        stop();
+}
+
+void RenderWorker::request(float alpha, int c)
+{
+        QMutexLocker lock(&m_mutex);
+        m_alpha = alpha;
+        m_c = c;
+        m_pending = true;
+        m_wakeup.wakeOne();
+}
+
+int RenderWorker::present()
+{
+        QMutexLocker lock(&m_mutex);
+        if (m_ready >= 0) {
+                m_front = m_ready;
+                m_ready = -1;
+        }
+        return m_front;
+}
+
+void RenderWorker::stop()
+{
+        {
+                QMutexLocker lock(&m_mutex);
+                m_quit = true;
+                m_wakeup.wakeOne();
+        }
+        wait();
+}
+
+void RenderWorker::run()
+{
+        for (;;) {
+                float alpha;
+                int c;
+                int target = 0;
+                {
+                        QMutexLocker lock(&m_mutex);
+                        while (!m_pending && !m_quit)
+                                m_wakeup.wait(&m_mutex);
+                        if (m_quit)
+                                return;
+
+                        alpha = m_alpha;
+                        c = m_c;
+                        m_pending = false;
+                        while (target == m_front || target == m_ready)
+                                ++target;
+                }
+
+                m_src->transform(alpha, c, m_surface[target]);
+
+                {
+                        QMutexLocker lock(&m_mutex);
+                        m_ready = target;
+                }
+                emit frameReady();
+        }
+}
+
+}
@@ -0,0 +1,85 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef RENDER_WORKER_H
+#define RENDER_WORKER_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "image.h"
+
+namespace ceng391 {
+
+// Runs the brightness/contrast point operation off the GUI thread. Only the
+// most recent request is kept, older ones that have not been started yet are
+// dropped. Results rotate through three surfaces: the one on screen, the
+// newest finished one and the one being rendered, so the worker never writes
+// into pixels that are being displayed.
+class RenderWorker: public QThread {
+        Q_OBJECT
+public:
+        static const int n_surfaces = 3;
+
+        RenderWorker(const Image* src, Image** surfaces, QObject* parent = 0);
+        ~RenderWorker();
+
+        // Queues a render of the source with the given parameters,
+        // replacing any request that has not been picked up yet.
+        void request(float alpha, int c);
+
+        // Makes the newest finished surface the displayed one and returns
+        // its index. Called from the GUI thread only.
+        int present();
+        int front() const { return m_front; }
+
+        void stop();
+signals:
+        void frameReady();
+protected:
+        void run();
+private:
+        const Image* m_src;
+        Image* m_surface[n_surfaces];
+
+        QMutex m_mutex;
+        QWaitCondition m_wakeup;
+        bool m_pending;
+        bool m_quit;
+        float m_alpha;
+        int m_c;
+        int m_front;
+        int m_ready;
+};
+
+}
+
+#endif
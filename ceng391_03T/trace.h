@@ -0,0 +1,89 @@
+// ------------------------------
+// Written by Mustafa Ozuysal
+// Contact <mustafaozuysal@iyte.edu.tr> for comments and bug reports
+// ------------------------------
+// Copyright (c) 2018, Mustafa Ozuysal
+// All rights reserved.
+// ------------------------------
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of the copyright holders nor the
+//       names of his/its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+// ------------------------------
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// ------------------------------
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <string>
+
+namespace ceng391 {
+
+// Scoped trace points for finding slow operations. While tracing is enabled
+// every TRACE_SCOPE records its name, start and duration into a ring buffer
+// of the calling thread, keeping the most recent events. When disabled a
+// trace point costs one relaxed atomic load. Defining CENG391_NO_TRACE
+// compiles them out entirely.
+//
+// Setting CENG391_TRACE=file.json in the environment enables tracing at
+// startup and writes the events to file.json at exit.
+
+extern std::atomic<bool> trace_on;
+
+inline bool trace_enabled() { return trace_on.load(std::memory_order_relaxed); }
+void set_trace_enabled(bool enabled);
+
+// Nanoseconds on the trace clock.
+long long trace_now();
+// Records a finished event. name must stay valid until the trace is written,
+// in practice a string literal.
+void trace_event(const char* name, long long start, long long end);
+
+// Writes every buffered event in the Chrome trace event format, which
+// chrome://tracing and Perfetto open. Best called while the traced threads
+// are idle.
+bool write_trace_json(const std::string& filename);
+void clear_trace();
+
+class TraceScope {
+public:
+        explicit TraceScope(const char* name)
+                : m_name(trace_enabled() ? name : 0), m_start(m_name ? trace_now() : 0) {}
+        ~TraceScope() { if (m_name) trace_event(m_name, m_start, trace_now()); }
+private:
+        TraceScope(const TraceScope&);
+        TraceScope& operator=(const TraceScope&);
+
+        const char* m_name;
+        long long m_start;
+};
+
+}
+
+#define CENG391_TRACE_JOIN2(a, b) a##b
+#define CENG391_TRACE_JOIN(a, b) CENG391_TRACE_JOIN2(a, b)
+
+#ifdef CENG391_NO_TRACE
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE(name) ceng391::TraceScope CENG391_TRACE_JOIN(trace_scope_, __LINE__)(name)
+#endif
+
+#endif